@@ -1,8 +1,12 @@
 #pragma once
 
 #include <assert.h>
+#include <stdint.h>
+#include <algorithm>
+#include <thread>
 #include <tuple>
 #include <utility>
+#include <vector>
 
 template<size_t NKEY, typename... COLS> class AvlTable;
 
@@ -46,12 +50,53 @@ namespace detail {
 		}
 	};
 
+	//stable sort; large inputs are sorted in chunks by several threads, which are merged pairwise afterwards
+	template<typename T, typename LESS> void parallelStableSort(std::vector<T> &v, LESS less)
+	{
+		const size_t ParallelMin = 1 << 16; //below this, starting threads costs more than it saves
+		size_t threads = std::thread::hardware_concurrency();
+		threads = min(threads, v.size() / (ParallelMin / 4));
+		if(v.size() < ParallelMin || threads < 2) {
+			std::stable_sort(v.begin(), v.end(), less);
+			return;
+		}
+
+		std::vector<size_t> bounds;
+		for(size_t i = 0; i <= threads; i++)
+			bounds.push_back(v.size() * i / threads);
+		std::vector<std::thread> workers;
+		for(size_t i = 1; i < threads; i++)
+			workers.emplace_back([&v, &bounds, less, i]() {
+				std::stable_sort(v.begin() + bounds[i], v.begin() + bounds[i + 1], less);
+			});
+		std::stable_sort(v.begin(), v.begin() + bounds[1], less);
+		for(auto &it : workers)
+			it.join();
+
+		//merging keeps stability, as the left chunk always holds the earlier elements
+		for(size_t width = 1; width < threads; width *= 2) {
+			workers.clear();
+			for(size_t i = 0; i + width < threads; i += 2 * width) {
+				size_t lo = bounds[i];
+				size_t mid = bounds[i + width];
+				size_t hi = bounds[min(i + 2 * width, threads)];
+				workers.emplace_back([&v, less, lo, mid, hi]() {
+					std::inplace_merge(v.begin() + lo, v.begin() + mid, v.begin() + hi, less);
+				});
+			}
+			for(auto &it : workers)
+				it.join();
+		}
+	}
+
 	template<typename... COLS> struct AvlNode {
 		using Tuple = std::tuple<COLS...>;
 
 		AvlNode(const COLS&... cells) :
 				b(0),
 				size(0),
+				hash(0),
+				hashSum(0),
 				p(nullptr),
 				l(nullptr),
 				r(nullptr),
@@ -61,6 +106,8 @@ namespace detail {
 		AvlNode() :
 				b(0),
 				size(0),
+				hash(0),
+				hashSum(0),
 				p(nullptr),
 				l(nullptr),
 				r(nullptr)
@@ -68,6 +115,8 @@ namespace detail {
 
 		char b;
 		size_t size;
+		uint64_t hash; //user supplied hash of this row
+		uint64_t hashSum; //sum of 'hash' over the subtree; order independent, so rotations only need a local update
 		AvlNode *p;
 		AvlNode *l;
 		AvlNode *r;
@@ -125,6 +174,9 @@ namespace detail {
 			n->l = p;
 			p->r = l;
 			p->p = n;
+
+			updateHash(p);
+			updateHash(n);
 		}
 
 		static void rotateRight(AvlNode *&root, AvlNode *n)
@@ -170,6 +222,30 @@ namespace detail {
 			n->r = p;
 			p->l = r;
 			p->p = n;
+
+			updateHash(p);
+			updateHash(n);
+		}
+
+		//link 'nodes[0..n-1]' (in order) into a perfectly balanced tree below 'p'; returns its root and sets 'height'
+		static AvlNode *build(AvlNode **nodes, size_t n, AvlNode *p, int &height)
+		{
+			if(n == 0) {
+				height = 0;
+				return nullptr;
+			}
+			int hl;
+			int hr;
+			size_t mid = n / 2;
+			AvlNode *root = nodes[mid];
+			root->p = p;
+			root->l = build(nodes, mid, root, hl);
+			root->r = build(nodes + mid + 1, n - mid - 1, root, hr);
+			root->b = hl - hr;
+			root->size = n;
+			updateHash(root);
+			height = max(hl, hr) + 1;
+			return root;
 		}
 
 		static size_t subtreeSize(AvlNode *n)
@@ -180,6 +256,48 @@ namespace detail {
 				return n->size;
 		}
 
+		static uint64_t subtreeHash(AvlNode *n)
+		{
+			if(n == nullptr)
+				return 0;
+			else
+				return n->hashSum;
+		}
+
+		static void updateHash(AvlNode *n)
+		{
+			n->hashSum = subtreeHash(n->l) + n->hash + subtreeHash(n->r);
+		}
+
+		//sum of 'hash' over all rows before position 'index'
+		static uint64_t prefixHash(AvlNode *n, size_t index)
+		{
+			uint64_t result = 0;
+			while(n != nullptr) {
+				size_t lsize = subtreeSize(n->l);
+				if(index < lsize)
+					n = n->l;
+				else if(index == lsize)
+					return result + subtreeHash(n->l);
+				else {
+					result += subtreeHash(n->l) + n->hash;
+					index -= lsize + 1;
+					n = n->r;
+				}
+			}
+			return result;
+		}
+
+		//position of 'n' within the whole tree
+		static size_t indexOf(AvlNode *n)
+		{
+			size_t index = subtreeSize(n->l);
+			for(; n->p != nullptr; n = n->p)
+				if(n == n->p->r)
+					index += subtreeSize(n->p->l) + 1;
+			return index;
+		}
+
 		static AvlNode *leftmost(AvlNode *n)
 		{
 			if(n == nullptr)
@@ -384,8 +502,10 @@ namespace detail {
 		{
 			AvlNode *c;
 
-			for(c = n; c != nullptr; c = c->p)
+			for(c = n; c != nullptr; c = c->p) {
 				c->size--;
+				updateHash(c);
+			}
 
 			while(n != nullptr) {
 				if(r) {
@@ -395,13 +515,16 @@ namespace detail {
 						if(c->b == -1) {
 							rotateLeft(root, c->r);
 							rotateRight(root, c->p);
+							n = c->p; //continue retracing at the new subtree root
 						}
 						else if(c->b == 0) {
 							rotateRight(root, c);
 							break;
 						}
-						else
+						else {
 							rotateRight(root, c);
+							n = c;
+						}
 					}
 					else if(n->b == 0) {
 						n->b = 1;
@@ -417,13 +540,16 @@ namespace detail {
 						if(c->b == 1) {
 							rotateRight(root, c->l);
 							rotateLeft(root, c->p);
+							n = c->p;
 						}
 						else if(c->b == 0) {
 							rotateLeft(root, c);
 							break;
 						}
-						else
+						else {
 							rotateLeft(root, c);
+							n = c;
+						}
 					}
 					else if(n->b == 0) {
 						n->b = -1;
@@ -465,6 +591,202 @@ namespace detail {
 			retracingInsert(root, n);
 		}
 
+		//split, join and range erase work on detached subtrees with known heights; the height of a child follows from the height and balance of its parent
+		static int height(AvlNode *n)
+		{
+			int h = 0;
+			for(; n != nullptr; n = n->b >= 0 ? n->l : n->r)
+				h++;
+			return h;
+		}
+
+		static int leftHeight(AvlNode *n, int h)
+		{
+			return n->b >= 0 ? h - 1 : h - 2;
+		}
+
+		static int rightHeight(AvlNode *n, int h)
+		{
+			return n->b <= 0 ? h - 1 : h - 2;
+		}
+
+		//make 'k' the parent of 'l' and 'r' without balancing; returns the resulting height
+		static int link(AvlNode *k, AvlNode *l, int hl, AvlNode *r, int hr)
+		{
+			k->l = l;
+			k->r = r;
+			if(l != nullptr)
+				l->p = k;
+			if(r != nullptr)
+				r->p = k;
+			k->b = hl - hr;
+			k->size = subtreeSize(l) + subtreeSize(r) + 1;
+			updateHash(k);
+			return max(hl, hr) + 1;
+		}
+
+		//all keys in 'l' < 'k' < all keys in 'r'; requires hl > hr + 1
+		static AvlNode *joinRight(AvlNode *l, int hl, AvlNode *k, AvlNode *r, int hr, int &h)
+		{
+			AvlNode *ll = l->l;
+			int hll = leftHeight(l, hl);
+			AvlNode *t;
+			int ht;
+			if(rightHeight(l, hl) <= hr + 1) {
+				t = k;
+				ht = link(k, l->r, rightHeight(l, hl), r, hr);
+			}
+			else
+				t = joinRight(l->r, rightHeight(l, hl), k, r, hr, ht);
+			if(ht <= hll + 1) {
+				h = link(l, ll, hll, t, ht);
+				return l;
+			}
+			AvlNode *tl = t->l;
+			AvlNode *tr = t->r;
+			int htl = leftHeight(t, ht);
+			int htr = rightHeight(t, ht);
+			if(htl <= htr) { //single rotation
+				int h1 = link(l, ll, hll, tl, htl);
+				h = link(t, l, h1, tr, htr);
+				return t;
+			}
+			else { //double rotation
+				int h1 = link(l, ll, hll, tl->l, leftHeight(tl, htl));
+				int h2 = link(t, tl->r, rightHeight(tl, htl), tr, htr);
+				h = link(tl, l, h1, t, h2);
+				return tl;
+			}
+		}
+
+		//mirror image of joinRight(); requires hr > hl + 1
+		static AvlNode *joinLeft(AvlNode *l, int hl, AvlNode *k, AvlNode *r, int hr, int &h)
+		{
+			AvlNode *rr = r->r;
+			int hrr = rightHeight(r, hr);
+			AvlNode *t;
+			int ht;
+			if(leftHeight(r, hr) <= hl + 1) {
+				t = k;
+				ht = link(k, l, hl, r->l, leftHeight(r, hr));
+			}
+			else
+				t = joinLeft(l, hl, k, r->l, leftHeight(r, hr), ht);
+			if(ht <= hrr + 1) {
+				h = link(r, t, ht, rr, hrr);
+				return r;
+			}
+			AvlNode *tl = t->l;
+			AvlNode *tr = t->r;
+			int htl = leftHeight(t, ht);
+			int htr = rightHeight(t, ht);
+			if(htr <= htl) {
+				int h1 = link(r, tr, htr, rr, hrr);
+				h = link(t, tl, htl, r, h1);
+				return t;
+			}
+			else {
+				int h1 = link(r, tr->r, rightHeight(tr, htr), rr, hrr);
+				int h2 = link(t, tl, htl, tr->l, leftHeight(tr, htr));
+				h = link(tr, t, h2, r, h1);
+				return tr;
+			}
+		}
+
+		//all keys in 'l' < 'k' < all keys in 'r'; O(|hl - hr|)
+		static AvlNode *join(AvlNode *l, int hl, AvlNode *k, AvlNode *r, int hr, int &h)
+		{
+			AvlNode *result;
+			if(hl > hr + 1)
+				result = joinRight(l, hl, k, r, hr, h);
+			else if(hr > hl + 1)
+				result = joinLeft(l, hl, k, r, hr, h);
+			else {
+				h = link(k, l, hl, r, hr);
+				result = k;
+			}
+			result->p = nullptr;
+			return result;
+		}
+
+		//remove the rightmost node of 'n' and return it in 'last'
+		static AvlNode *splitLast(AvlNode *n, int hn, AvlNode *&last, int &h)
+		{
+			if(n->r == nullptr) {
+				last = n;
+				h = leftHeight(n, hn);
+				if(n->l != nullptr)
+					n->l->p = nullptr;
+				return n->l;
+			}
+			int hr;
+			AvlNode *r = splitLast(n->r, rightHeight(n, hn), last, hr);
+			return join(n->l, leftHeight(n, hn), n, r, hr, h);
+		}
+
+		//all keys in 'l' < all keys in 'r'
+		static AvlNode *join2(AvlNode *l, int hl, AvlNode *r, int hr, int &h)
+		{
+			if(l == nullptr) {
+				h = hr;
+				return r;
+			}
+			AvlNode *last;
+			int hrest;
+			AvlNode *rest = splitLast(l, hl, last, hrest);
+			return join(rest, hrest, last, r, hr, h);
+		}
+
+		//'l' receives the first 'index' nodes of 'n', 'r' the remaining ones; O(log n)
+		static void splitAt(AvlNode *n, int hn, size_t index, AvlNode *&l, int &hl, AvlNode *&r, int &hr)
+		{
+			if(n == nullptr) {
+				l = r = nullptr;
+				hl = hr = 0;
+				return;
+			}
+			AvlNode *nl = n->l;
+			AvlNode *nr = n->r;
+			int hnl = leftHeight(n, hn);
+			int hnr = rightHeight(n, hn);
+			if(nl != nullptr)
+				nl->p = nullptr;
+			if(nr != nullptr)
+				nr->p = nullptr;
+			if(index <= subtreeSize(nl)) {
+				AvlNode *m;
+				int hm;
+				splitAt(nl, hnl, index, l, hl, m, hm);
+				r = join(m, hm, n, nr, hnr, hr);
+			}
+			else {
+				AvlNode *m;
+				int hm;
+				splitAt(nr, hnr, index - subtreeSize(nl) - 1, m, hm, r, hr);
+				l = join(nl, hnl, n, m, hm, hl);
+			}
+		}
+
+		//call 'fn' for all rows of 'n' in order and delete the nodes; the nodes are deleted, even if 'fn' throws
+		template<typename F> static void drain(AvlNode *n, F &fn)
+		{
+			if(n == nullptr)
+				return;
+			AvlNode *l = n->l;
+			n->l = nullptr;
+			try {
+				drain(l, fn);
+				fn(n->cells);
+			}
+			catch(...) {
+				deleteNode(n);
+				throw;
+			}
+			AvlNode *r = n->r;
+			delete n;
+			drain(r, fn);
+		}
+
 		static void removeNode(AvlNode *&root, AvlNode *x)
 		{
 			AvlNode *y;
@@ -548,6 +870,7 @@ namespace detail {
 	};
 
 	template<size_t NKEY, typename... COLS> class Iterator {
+		template<size_t, typename...> friend class ::AvlTable;
 		using RowTuple = std::tuple<COLS...>;
 		using KeyTuple = typename TupleFront<RowTuple, NKEY>::TYPE;
 		public:
@@ -725,7 +1048,10 @@ template<size_t NKEY, typename... COLS> class AvlTable {
 		AvlTable &operator=(const AvlTable &other) = delete;
 
 		AvlTable() :
-				_root(nullptr)
+				_root(nullptr),
+				_fingering(false),
+				_finger(nullptr),
+				_fingerIndex(NoIndex)
 		{}
 
 		~AvlTable()
@@ -737,13 +1063,21 @@ template<size_t NKEY, typename... COLS> class AvlTable {
 		{
 			AvlNode::deleteNode(_root);
 			_root = nullptr;
+			touch(nullptr);
+		}
+
+		//finger search: key and position based lookups and inserts start at the last touched row instead of at the root and climb only as far as needed.
+		//ascending or clustered access then needs O(log d) comparisons for a distance of d rows, i.e. O(1) for the neighbouring row, plus the usual rebalancing.
+		void setFinger(bool enabled)
+		{
+			_fingering = enabled;
+			touch(nullptr);
 		}
 
 		template<size_t COL> typename std::tuple_element<COL, RowTuple>::type cellAt(size_t index) const
 		{
 			static_assert(COL < sizeof...(COLS), "no such column");
-			AvlNode *n = _root;
-			AvlNode::findIndex(n, index);
+			AvlNode *n = nodeAt(index);
 			if(n == NULL)
 				throw 1;
 			return std::get<COL>(n->cells);
@@ -752,13 +1086,12 @@ template<size_t NKEY, typename... COLS> class AvlTable {
 		template<size_t COL, typename... K> typename std::tuple_element<COL, RowTuple>::type cell(K... argkey) const
 		{
 			static_assert(COL < sizeof...(COLS), "no such column");
-			AvlNode *n = _root;
-			size_t index;
+			bool found;
 			typename detail::TupleFront<RowTuple, sizeof...(K)>::TYPE key(argkey...);
-			if(!AvlNode::template findLower<NKEY>(n, index, key))
-				return typename std::tuple_element<COL, RowTuple>::type();
-			else if(n == NULL)
+			AvlNode *n = locate(fingerStart(), key, found);
+			if(!found || n == NULL)
 				return typename std::tuple_element<COL, RowTuple>::type();
+			touch(n);
 			return std::get<COL>(n->cells);
 		}
 
@@ -785,10 +1118,12 @@ template<size_t NKEY, typename... COLS> class AvlTable {
 
 		template<typename... K> bool contains(K... argkey) {
 			static_assert(sizeof...(K) <= NKEY, "given key exceeds number of key columns");
-			AvlNode *n = _root;
-			size_t index;
+			bool found;
 			typename detail::TupleFront<RowTuple, sizeof...(K)>::TYPE key(argkey...);
-			return AvlNode::template findLower<NKEY>(n, index, key);
+			AvlNode *n = locate(fingerStart(), key, found);
+			if(n != nullptr)
+				touch(n);
+			return found;
 		}
 
 		size_t insertAt(size_t index, const COLS&... cols)
@@ -800,6 +1135,7 @@ template<size_t NKEY, typename... COLS> class AvlTable {
 			
 			AvlNode *n = new AvlNode(cols...);
 			AvlNode::insertNode(_root, pivot, n);
+			touch(n, index);
 			return index;
 		}
 
@@ -812,6 +1148,7 @@ template<size_t NKEY, typename... COLS> class AvlTable {
 			AvlNode::template findUpper<NKEY>(pivot, index, row);
 			AvlNode *n = new AvlNode(cols...);
 			AvlNode::insertNode(_root, pivot, n);
+			touch(n, index);
 			return index;
 		}
 
@@ -824,53 +1161,210 @@ template<size_t NKEY, typename... COLS> class AvlTable {
 			AvlNode::template findLower<NKEY>(pivot, index, row);
 			AvlNode *n = new AvlNode(cols...);
 			AvlNode::insertNode(_root, pivot, n);
+			touch(n, index);
 			return index;
 		}
 
 		size_t insert(const COLS&...cols)
 		{
-			AvlNode *pivot = _root;
-			size_t index;
-			RowTuple row(cols...);
+			return insert(Iterator(_root, fingerStart(), NoIndex), cols...).index();
+		}
 
-			AvlNode::template findUpper<NKEY>(pivot, index, row);
+		//like insert(), but the search starts at 'hint' (see std::map::emplace_hint), which has to refer to a row of this table or be an end iterator.
+		//inserting next to the previously inserted row this way needs O(1) comparisons.
+		Iterator insert(const Iterator &hint, const COLS&... cols)
+		{
+			bool found;
+			RowTuple row(cols...);
+			AvlNode *pivot = locate(hint._cur, row, found);
+			while(pivot != nullptr && detail::Compare<0, NKEY, RowTuple, RowTuple>::exec(pivot->cells, row) == 0)
+				pivot = AvlNode::successor(pivot);
 			AvlNode *n = new AvlNode(cols...);
 			AvlNode::insertNode(_root, pivot, n);
-			return index;
+			return iterator(n);
 		}
 
 		void putAt(size_t index, const COLS&... cols)
 		{
-			AvlNode *pivot = _root;
+			AvlNode *pivot = nodeAt(index);
 			RowTuple row(cols...);
-			if(!AvlNode::findIndex(pivot, index))
+			if(pivot == nullptr)
 				throw 1; //TODO don't throw; what to do? idea would be to return bool, but see also other xAt functions
 			pivot->cells = row;
 		}
 
 		size_t put(const COLS&... cols)
 		{
-			AvlNode *pivot = _root;
-			size_t index;
+			return put(Iterator(_root, fingerStart(), NoIndex), cols...).index();
+		}
+
+		//like put(), but the search starts at 'hint'; see insert(hint, ...)
+		Iterator put(const Iterator &hint, const COLS&... cols)
+		{
+			bool found;
 			RowTuple row(cols...);
-			if(AvlNode::template findLower<NKEY>(pivot, index, row))
-				pivot->cells = row;
+			AvlNode *n = locate(hint._cur, row, found);
+			if(found)
+				n->cells = row;
 			else {
-				AvlNode *n = new AvlNode(cols...);
+				AvlNode *pivot = n;
+				n = new AvlNode(cols...);
 				AvlNode::insertNode(_root, pivot, n);
 			}
-			return index;
+			return iterator(n);
 		}
 
-		size_t removeAt(size_t index, size_t n = 1)
+		//merge 'rows' into the table and rebuild it as a perfectly balanced tree: O(m log m) for sorting 'rows' (in parallel for large inputs) plus O(n + m) for the merge.
+		//equal keys resolve last-writer-wins: later rows win over earlier ones and 'rows' win over rows already in the table; 'superseded' is called for every row dropped that way.
+		template<typename F> void bulkLoad(std::vector<RowTuple> &&rows, F superseded)
 		{
-			for(size_t i = 0; i < n; i++) { //TODO this is optimizable... idea: we should get the new node at position 'index' from removeNode(), so we just need to delete that node until there is no further node or n has reached 0.
-				AvlNode *pivot = _root;
-				if(!AvlNode::findIndex(pivot, index))
-					return i;
-				AvlNode::removeNode(_root, pivot);
+			auto less = [](const RowTuple &a, const RowTuple &b) {
+				return detail::Compare<0, NKEY, RowTuple, RowTuple>::exec(a, b) < 0;
+			};
+			detail::parallelStableSort(rows, less);
+
+			std::vector<AvlNode*> nodes;
+			nodes.reserve(size() + rows.size());
+			AvlNode *cur = AvlNode::leftmost(_root);
+			for(size_t i = 0; i < rows.size(); i++) {
+				if(i + 1 < rows.size() && !less(rows[i], rows[i + 1])) { //a later row has the same key
+					superseded(rows[i]);
+					continue;
+				}
+				for(; cur != nullptr && less(cur->cells, rows[i]); cur = AvlNode::successor(cur))
+					nodes.push_back(cur);
+				if(cur != nullptr && !less(rows[i], cur->cells)) { //replace existing row, keep its node
+					superseded(cur->cells);
+					cur->cells = std::move(rows[i]);
+					nodes.push_back(cur);
+					cur = AvlNode::successor(cur);
+				}
+				else {
+					AvlNode *n = new AvlNode();
+					n->cells = std::move(rows[i]);
+					nodes.push_back(n);
+				}
 			}
-			return n;
+			for(; cur != nullptr; cur = AvlNode::successor(cur))
+				nodes.push_back(cur);
+			rows.clear();
+
+			int height;
+			_root = AvlNode::build(nodes.data(), nodes.size(), nullptr, height);
+			touch(nullptr);
+		}
+
+		void bulkLoad(std::vector<RowTuple> &&rows)
+		{
+			bulkLoad(std::move(rows), [](const RowTuple&) {});
+		}
+
+		//each row carries a user supplied hash (initially 0). sums over arbitrary position ranges are available in O(log n)
+		void setHashAt(size_t index, uint64_t hash)
+		{
+			AvlNode *n = nodeAt(index);
+			if(n == nullptr)
+				throw 1;
+			uint64_t delta = hash - n->hash;
+			n->hash = hash;
+			for(; n != nullptr; n = n->p)
+				n->hashSum += delta;
+		}
+
+		uint64_t hashAt(size_t index) const
+		{
+			AvlNode *n = nodeAt(index);
+			if(n == nullptr)
+				throw 1;
+			return n->hash;
+		}
+
+		//sum of row hashes in positions [l, u)
+		uint64_t hashRange(size_t l, size_t u) const
+		{
+			if(u <= l)
+				return 0;
+			return AvlNode::prefixHash(_root, u) - AvlNode::prefixHash(_root, l);
+		}
+
+		size_t removeAt(size_t index, size_t n = 1)
+		{
+			if(n != 1)
+				return eraseRange(index, index + n);
+			AvlNode *pivot = nodeAt(index);
+			if(pivot == nullptr)
+				return 0;
+			touch(nullptr);
+			AvlNode::removeNode(_root, pivot);
+			return 1;
+		}
+
+		//remove the rows in positions [lower, upper) in O(log n + k); 'removed' is called for each of them in order, after the table has been updated.
+		//returns the number of removed rows
+		template<typename F> size_t eraseRange(size_t lower, size_t upper, F removed)
+		{
+			upper = detail::min(upper, size());
+			if(upper <= lower)
+				return 0;
+			AvlNode *l;
+			AvlNode *m;
+			AvlNode *r;
+			int hl;
+			int hm;
+			int hr;
+			AvlNode::splitAt(_root, AvlNode::height(_root), upper, m, hm, r, hr);
+			AvlNode::splitAt(m, hm, lower, l, hl, m, hm);
+			_root = AvlNode::join2(l, hl, r, hr, hl);
+			if(_root != nullptr)
+				_root->p = nullptr;
+			touch(nullptr);
+			AvlNode::drain(m, removed);
+			return upper - lower;
+		}
+
+		size_t eraseRange(size_t lower, size_t upper)
+		{
+			return eraseRange(lower, upper, [](const RowTuple&) {});
+		}
+
+		//move the rows with a key >= 'argkey' (compared like lower()) from this table to 'right', which has to be empty; O(log n)
+		template<typename... K> void split(AvlTable &right, K... argkey)
+		{
+			static_assert(sizeof...(K) <= NKEY, "given key exceeds number of key columns");
+			AvlNode *n = _root;
+			size_t index;
+			typename detail::TupleFront<RowTuple, sizeof...(K)>::TYPE key(argkey...);
+			AvlNode::template findLower<NKEY>(n, index, key);
+			splitAt(right, index);
+		}
+
+		//move the rows in positions >= 'index' from this table to 'right', which has to be empty; O(log n)
+		void splitAt(AvlTable &right, size_t index)
+		{
+			if(right._root != nullptr)
+				throw 1;
+			touch(nullptr);
+			int hl;
+			int hr;
+			AvlNode::splitAt(_root, AvlNode::height(_root), index, _root, hl, right._root, hr);
+			if(_root != nullptr)
+				_root->p = nullptr;
+			if(right._root != nullptr)
+				right._root->p = nullptr;
+		}
+
+		//append all rows of 'right' to this table, leaving 'right' empty; its keys must not be less than the keys of this table. O(log n)
+		void join(AvlTable &right)
+		{
+			if(this == &right)
+				throw 1;
+			touch(nullptr);
+			right.touch(nullptr);
+			int h;
+			_root = AvlNode::join2(_root, AvlNode::height(_root), right._root, AvlNode::height(right._root), h);
+			if(_root != nullptr)
+				_root->p = nullptr;
+			right._root = nullptr;
 		}
 
 		template<typename... K> size_t remove(K... argkey)
@@ -887,20 +1381,21 @@ template<size_t NKEY, typename... COLS> class AvlTable {
 
 		Iterator at(size_t index) const
 		{
-			AvlNode *n = _root;
-			if(!AvlNode::findIndex(n, index))
+			if(index > size())
 				throw 1;
-			return Iterator(_root, n, index);
+			return Iterator(_root, nodeAt(index), index);
 		}
 
 		template<typename... K> Iterator single(K... argkey) const
 		{
 			static_assert(sizeof...(K) <= NKEY, "given key exceeds number of key columns");
-			AvlNode *n = _root;
-			size_t index;
+			bool found;
 			typename detail::TupleFront<RowTuple, sizeof...(K)>::TYPE key(argkey...);
-			if(!(AvlNode::template findLower<NKEY>(n, index, key)))
+			AvlNode *n = locate(fingerStart(), key, found);
+			if(!found)
 				return Iterator();
+			size_t index = AvlNode::indexOf(n);
+			touch(n, index);
 			return Iterator(_root, n, index, AvlNode::successor(n), index + 1);
 		}
 
@@ -919,13 +1414,18 @@ template<size_t NKEY, typename... COLS> class AvlTable {
 		}
 
 		template<typename... K> Iterator lower(K... argkey) const
+		{
+			return lower(Iterator(_root, fingerStart(), NoIndex), argkey...);
+		}
+
+		//like lower(), but the search starts at 'hint'; see insert(hint, ...)
+		template<typename... K> Iterator lower(const Iterator &hint, K... argkey) const
 		{
 			static_assert(sizeof...(K) <= NKEY, "given key exceeds number of key columns");
-			AvlNode *n = _root;
-			size_t index;
+			bool found;
 			typename detail::TupleFront<RowTuple, sizeof...(K)>::TYPE key(argkey...);
-			AvlNode::template findLower<NKEY>(n, index, key); //TODO is this correct? thoughts: remove if() clause
-			return Iterator(_root, n, index);
+			AvlNode *n = locate(hint._cur, key, found);
+			return iterator(n);
 		}
 
 		template<typename... K> Iterator upper(K... argkey) const
@@ -967,8 +1467,95 @@ template<size_t NKEY, typename... COLS> class AvlTable {
 		}
 
 	protected:
+		static const size_t NoIndex = size_t(-1);
+
+		AvlNode *fingerStart() const
+		{
+			return _fingering ? _finger : nullptr;
+		}
+
+		//remember 'n' as finger, if finger search is enabled; 'index' is its position, if known. nullptr: forget the finger after structural changes
+		void touch(AvlNode *n, size_t index = NoIndex) const
+		{
+			if(_fingering || n == nullptr) {
+				_finger = n;
+				_fingerIndex = index;
+			}
+		}
+
+		Iterator iterator(AvlNode *n) const
+		{
+			if(n == nullptr)
+				return Iterator(_root, nullptr, size());
+			size_t index = AvlNode::indexOf(n);
+			touch(n, index);
+			return Iterator(_root, n, index);
+		}
+
+		//node at position 'index'; nullptr, if 'index' is out of range. with finger search, the walk starts at the finger
+		AvlNode *nodeAt(size_t index) const
+		{
+			AvlNode *n = fingerStart();
+			if(n != nullptr && _fingerIndex == NoIndex)
+				_fingerIndex = AvlNode::indexOf(n);
+			if(n == nullptr) {
+				n = _root;
+				if(!AvlNode::findIndex(n, index) || n == nullptr)
+					return nullptr;
+			}
+			else {
+				size_t start = _fingerIndex - AvlNode::subtreeSize(n->l); //position of the first row in the subtree of 'n'
+				while(index < start || index >= start + n->size) {
+					AvlNode *p = n->p;
+					if(p == nullptr)
+						return nullptr;
+					else if(n == p->r)
+						start -= AvlNode::subtreeSize(p->l) + 1;
+					n = p;
+				}
+				AvlNode::findIndex(n, index - start);
+			}
+			if(_fingering)
+				touch(n, index);
+			return n;
+		}
+
+		//first node with a key >= 'key' (nullptr: none), searching from 'start' (nullptr: root). 'found' tells, whether its key equals 'key'.
+		//the search climbs from 'start' up to the first ancestor whose subtree covers 'key', so nearby keys are found with few comparisons.
+		template<typename... T> AvlNode *locate(AvlNode *start, const std::tuple<T...> &key, bool &found) const
+		{
+			using Compare = detail::Compare<0, detail::min(sizeof...(T), NKEY), RowTuple, std::tuple<T...>>;
+			AvlNode *x = start;
+			if(x == nullptr)
+				x = _root;
+			else if(Compare::exec(x->cells, key) < 0) {
+				//key is right of 'x': climb until 'x' is the left child of a node >= key
+				for(; x->p != nullptr; x = x->p)
+					if(x == x->p->l && Compare::exec(x->p->cells, key) >= 0)
+						break;
+			}
+			else {
+				//key is left of or at 'x': climb until 'x' is the right child of a node < key
+				for(; x->p != nullptr; x = x->p)
+					if(x == x->p->r && Compare::exec(x->p->cells, key) < 0)
+						break;
+			}
+			AvlNode *n = x;
+			size_t index;
+			found = AvlNode::template findLower<NKEY>(n, index, key);
+			if(n == nullptr && x != nullptr && x->p != nullptr) { //all of the subtree is < key; its parent is the next node
+				n = x->p;
+				found = Compare::exec(n->cells, key) == 0;
+			}
+			else if(n != nullptr && found)
+				found = Compare::exec(n->cells, key) == 0;
+			return n;
+		}
 
 		AvlNode *_root;
+		bool _fingering;
+		mutable AvlNode *_finger; //last touched node; only used with finger search enabled
+		mutable size_t _fingerIndex; //position of '_finger'; NoIndex: unknown
 };
 
 /*
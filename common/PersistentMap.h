@@ -0,0 +1,267 @@
+#pragma once
+
+#include <assert.h>
+#include <stddef.h>
+#include <atomic>
+#include <functional>
+
+//ordered map with structural sharing: copying a map is O(1), put() and remove() copy only the path to the changed node (O(log n)).
+//nodes are immutable once shared, so different copies may be read concurrently from different threads without locking.
+//a single copy must not be modified and read concurrently.
+template<typename K, typename V> class PersistentMap {
+	private:
+		struct Node {
+			Node(const K &key, const V &value, Node *l, Node *r) :
+					refs(1),
+					height(max(heightOf(l), heightOf(r)) + 1),
+					size(sizeOf(l) + sizeOf(r) + 1),
+					l(l),
+					r(r),
+					key(key),
+					value(value)
+			{}
+
+			~Node() {
+				release(l);
+				release(r);
+			}
+
+			std::atomic<int> refs;
+			int height;
+			size_t size;
+			Node *l; //owned reference
+			Node *r; //owned reference
+			const K key;
+			const V value;
+		};
+
+	public:
+		PersistentMap() : _root(nullptr) {}
+		PersistentMap(const PersistentMap &other) : _root(retain(other._root)) {}
+		PersistentMap(PersistentMap &&other) : _root(other._root) {
+			other._root = nullptr;
+		}
+		~PersistentMap() {
+			release(_root);
+		}
+
+		PersistentMap &operator=(const PersistentMap &other) {
+			Node *root = retain(other._root);
+			release(_root);
+			_root = root;
+			return *this;
+		}
+
+		PersistentMap &operator=(PersistentMap &&other) {
+			if(this != &other) {
+				release(_root);
+				_root = other._root;
+				other._root = nullptr;
+			}
+			return *this;
+		}
+
+		size_t size() const {
+			return sizeOf(_root);
+		}
+
+		bool isEmpty() const {
+			return !_root;
+		}
+
+		void clear() {
+			release(_root);
+			_root = nullptr;
+		}
+
+		//insert or replace
+		void put(const K &key, const V &value) {
+			Node *root = insert(_root, key, value);
+			release(_root);
+			_root = root;
+		}
+
+		bool remove(const K &key) {
+			if(!find(key))
+				return false;
+			Node *root = erase(_root, key);
+			release(_root);
+			_root = root;
+			return true;
+		}
+
+		//returns nullptr, if 'key' does not exist
+		const V *find(const K &key) const {
+			const Node *n = _root;
+			while(n) {
+				if(key < n->key)
+					n = n->l;
+				else if(n->key < key)
+					n = n->r;
+				else
+					return &n->value;
+			}
+			return nullptr;
+		}
+
+		bool contains(const K &key) const {
+			return find(key);
+		}
+
+		//index of first element >= key
+		size_t lower(const K &key) const {
+			size_t index = 0;
+			const Node *n = _root;
+			while(n) {
+				if(n->key < key) {
+					index += sizeOf(n->l) + 1;
+					n = n->r;
+				}
+				else
+					n = n->l;
+			}
+			return index;
+		}
+
+		//index of first element > key
+		size_t upper(const K &key) const {
+			size_t index = 0;
+			const Node *n = _root;
+			while(n) {
+				if(key < n->key)
+					n = n->l;
+				else {
+					index += sizeOf(n->l) + 1;
+					n = n->r;
+				}
+			}
+			return index;
+		}
+
+		const K &keyAt(size_t index) const {
+			return nodeAt(index)->key;
+		}
+
+		const V &valueAt(size_t index) const {
+			return nodeAt(index)->value;
+		}
+
+		//in-order traversal of [l, u); stops early, if 'fn' returns false
+		bool foreachRange(size_t l, size_t u, const std::function<bool(const K &key, const V &value)> &fn) const {
+			return traverse(_root, 0, l, u, fn);
+		}
+
+	private:
+		static int max(int a, int b) {
+			return a > b ? a : b;
+		}
+
+		static int heightOf(const Node *n) {
+			return n ? n->height : 0;
+		}
+
+		static size_t sizeOf(const Node *n) {
+			return n ? n->size : 0;
+		}
+
+		static Node *retain(Node *n) {
+			if(n)
+				n->refs.fetch_add(1, std::memory_order_relaxed);
+			return n;
+		}
+
+		static void release(Node *n) {
+			if(n && n->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				delete n;
+		}
+
+		const Node *nodeAt(size_t index) const {
+			assert(index < size());
+			const Node *n = _root;
+			for(;;) {
+				size_t ls = sizeOf(n->l);
+				if(index < ls)
+					n = n->l;
+				else if(index > ls) {
+					index -= ls + 1;
+					n = n->r;
+				}
+				else
+					return n;
+			}
+		}
+
+		//all functions below take ownership of the passed subtrees 'l' and 'r' and return an owned reference
+		static Node *balance(const K &key, const V &value, Node *l, Node *r) {
+			int hl = heightOf(l);
+			int hr = heightOf(r);
+			Node *result;
+			if(hl > hr + 1) {
+				if(heightOf(l->l) >= heightOf(l->r))
+					result = new Node(l->key, l->value, retain(l->l), new Node(key, value, retain(l->r), r));
+				else {
+					Node *lr = l->r;
+					result = new Node(lr->key, lr->value, new Node(l->key, l->value, retain(l->l), retain(lr->l)), new Node(key, value, retain(lr->r), r));
+				}
+				release(l);
+			}
+			else if(hr > hl + 1) {
+				if(heightOf(r->r) >= heightOf(r->l))
+					result = new Node(r->key, r->value, new Node(key, value, l, retain(r->l)), retain(r->r));
+				else {
+					Node *rl = r->l;
+					result = new Node(rl->key, rl->value, new Node(key, value, l, retain(rl->l)), new Node(r->key, r->value, retain(rl->r), retain(r->r)));
+				}
+				release(r);
+			}
+			else
+				result = new Node(key, value, l, r);
+			return result;
+		}
+
+		static Node *insert(Node *n, const K &key, const V &value) {
+			if(!n)
+				return new Node(key, value, nullptr, nullptr);
+			else if(key < n->key)
+				return balance(n->key, n->value, insert(n->l, key, value), retain(n->r));
+			else if(n->key < key)
+				return balance(n->key, n->value, retain(n->l), insert(n->r, key, value));
+			else
+				return new Node(key, value, retain(n->l), retain(n->r));
+		}
+
+		static Node *eraseMin(Node *n) {
+			if(!n->l)
+				return retain(n->r);
+			return balance(n->key, n->value, eraseMin(n->l), retain(n->r));
+		}
+
+		//'key' must exist below 'n'
+		static Node *erase(Node *n, const K &key) {
+			if(key < n->key)
+				return balance(n->key, n->value, erase(n->l, key), retain(n->r));
+			else if(n->key < key)
+				return balance(n->key, n->value, retain(n->l), erase(n->r, key));
+			else if(!n->l)
+				return retain(n->r);
+			else if(!n->r)
+				return retain(n->l);
+			const Node *m = n->r;
+			while(m->l)
+				m = m->l;
+			return balance(m->key, m->value, retain(n->l), eraseMin(n->r));
+		}
+
+		static bool traverse(const Node *n, size_t base, size_t l, size_t u, const std::function<bool(const K &key, const V &value)> &fn) {
+			if(!n || base >= u || base + n->size <= l)
+				return true;
+			size_t index = base + sizeOf(n->l);
+			if(!traverse(n->l, base, l, u, fn))
+				return false;
+			if(index >= l && index < u && !fn(n->key, n->value))
+				return false;
+			return traverse(n->r, index + 1, l, u, fn);
+		}
+
+		Node *_root;
+};
@@ -3,6 +3,12 @@
 #include <string.h>
 #include <errno.h>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "base32.h"
 
 static const unsigned char enc_table[32] = {
@@ -12,6 +18,14 @@ static const unsigned char enc_table[32] = {
 	'Y', 'Z', '2', '3', '4', '5', '6', '7'
 };
 
+static const unsigned char enc_table_lower[32] = {
+	'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h',
+	'i', 'j', 'k', 'l', 'm', 'n', 'o', 'p',
+	'q', 'r', 's', 't', 'u', 'v', 'w', 'x',
+	'y', 'z', '2', '3', '4', '5', '6', '7'
+};
+
+/* accepts both upper and lower case letters */
 static const unsigned char dec_table[128] = {
 	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
 	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
@@ -19,10 +33,16 @@ static const unsigned char dec_table[128] = {
 	0xff, 0xff, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f,  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
 	0xff, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,  0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
 	0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,  0x17, 0x18, 0x19, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+	0xff, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,  0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+	0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,  0x17, 0x18, 0x19, 0xff, 0xff, 0xff, 0xff, 0xff
 };
 
+#if defined(__AVX2__)
+#define SIMD_WIDTH 32
+#elif defined(__SSE2__)
+#define SIMD_WIDTH 16
+#endif
+
 static inline uint8_t bits(
 		uint8_t value,
 		uint8_t srcbit,
@@ -37,6 +57,160 @@ static inline uint8_t bits(
 		return value << shift;
 }
 
+/* 5 bytes -> 8 quintets */
+static inline void unpack(
+		uint8_t *dest,
+		const unsigned char *si)
+{
+	uint64_t v =
+		(uint64_t)si[0] << 32 |
+		(uint64_t)si[1] << 24 |
+		(uint64_t)si[2] << 16 |
+		(uint64_t)si[3] << 8 |
+		(uint64_t)si[4];
+	int i;
+
+	for(i = 0; i < 8; i++)
+		dest[i] = (v >> (35 - 5 * i)) & 0x1f;
+}
+
+/* 8 quintets -> 5 bytes */
+static inline void pack(
+		char *di,
+		const uint8_t *block)
+{
+	uint64_t v = 0;
+	int i;
+
+	for(i = 0; i < 8; i++)
+		v = v << 5 | block[i];
+	di[0] = v >> 32;
+	di[1] = v >> 24;
+	di[2] = v >> 16;
+	di[3] = v >> 8;
+	di[4] = v;
+}
+
+#ifdef SIMD_WIDTH
+/* quintets -> characters, SIMD_WIDTH at once */
+static inline void enc_simd(
+		char *di,
+		const uint8_t *block,
+		char alpha)
+{
+#if defined(__AVX2__)
+	__m256i v = _mm256_loadu_si256((const __m256i*)block);
+	__m256i digit = _mm256_cmpgt_epi8(v, _mm256_set1_epi8(25));
+	__m256i c = _mm256_add_epi8(v, _mm256_set1_epi8(alpha));
+	c = _mm256_add_epi8(c, _mm256_and_si256(digit, _mm256_set1_epi8('2' - 26 - alpha)));
+	_mm256_storeu_si256((__m256i*)di, c);
+#else
+	__m128i v = _mm_loadu_si128((const __m128i*)block);
+	__m128i digit = _mm_cmpgt_epi8(v, _mm_set1_epi8(25));
+	__m128i c = _mm_add_epi8(v, _mm_set1_epi8(alpha));
+	c = _mm_add_epi8(c, _mm_and_si128(digit, _mm_set1_epi8('2' - 26 - alpha)));
+	_mm_storeu_si128((__m128i*)di, c);
+#endif
+}
+
+/* characters -> quintets, SIMD_WIDTH at once; returns 0 if any character is invalid */
+static inline int dec_simd(
+		uint8_t *block,
+		const char *si)
+{
+#if defined(__AVX2__)
+	__m256i c = _mm256_loadu_si256((const __m256i*)si);
+	__m256i lc = _mm256_or_si256(c, _mm256_set1_epi8(0x20));
+	__m256i alpha = _mm256_and_si256(
+			_mm256_cmpgt_epi8(lc, _mm256_set1_epi8('a' - 1)),
+			_mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lc));
+	__m256i digit = _mm256_and_si256(
+			_mm256_cmpgt_epi8(c, _mm256_set1_epi8('2' - 1)),
+			_mm256_cmpgt_epi8(_mm256_set1_epi8('7' + 1), c));
+	__m256i v = _mm256_or_si256(
+			_mm256_and_si256(alpha, _mm256_sub_epi8(lc, _mm256_set1_epi8('a'))),
+			_mm256_and_si256(digit, _mm256_sub_epi8(c, _mm256_set1_epi8('2' - 26))));
+	if((uint32_t)_mm256_movemask_epi8(_mm256_or_si256(alpha, digit)) != 0xffffffffu)
+		return 0;
+	_mm256_storeu_si256((__m256i*)block, v);
+#else
+	__m128i c = _mm_loadu_si128((const __m128i*)si);
+	__m128i lc = _mm_or_si128(c, _mm_set1_epi8(0x20));
+	__m128i alpha = _mm_and_si128(
+			_mm_cmpgt_epi8(lc, _mm_set1_epi8('a' - 1)),
+			_mm_cmpgt_epi8(_mm_set1_epi8('z' + 1), lc));
+	__m128i digit = _mm_and_si128(
+			_mm_cmpgt_epi8(c, _mm_set1_epi8('2' - 1)),
+			_mm_cmpgt_epi8(_mm_set1_epi8('7' + 1), c));
+	__m128i v = _mm_or_si128(
+			_mm_and_si128(alpha, _mm_sub_epi8(lc, _mm_set1_epi8('a'))),
+			_mm_and_si128(digit, _mm_sub_epi8(c, _mm_set1_epi8('2' - 26))));
+	if(_mm_movemask_epi8(_mm_or_si128(alpha, digit)) != 0xffff)
+		return 0;
+	_mm_storeu_si128((__m128i*)block, v);
+#endif
+	return 1;
+}
+#endif
+
+static void encode(
+		char *di,
+		const unsigned char *si,
+		size_t n,
+		const unsigned char *table)
+{
+	unsigned char carry;
+
+#ifdef SIMD_WIDTH
+	uint8_t block[SIMD_WIDTH];
+	int i;
+
+	while(n >= SIMD_WIDTH / 8 * 5) {
+		for(i = 0; i < SIMD_WIDTH / 8; i++)
+			unpack(block + 8 * i, si + 5 * i);
+		enc_simd(di, block, table[0]);
+		di += SIMD_WIDTH;
+		si += SIMD_WIDTH / 8 * 5;
+		n -= SIMD_WIDTH / 8 * 5;
+	}
+#endif
+
+	while(n >= 5) {
+		*di++ = table[bits(si[0], 7, 4, 5)];
+		*di++ = table[bits(si[0], 2, 4, 3) | bits(si[1], 7, 1, 2)];
+		*di++ = table[bits(si[1], 5, 4, 5)];
+		*di++ = table[bits(si[1], 0, 4, 1) | bits(si[2], 7, 3, 4)];
+		*di++ = table[bits(si[2], 3, 4, 4) | bits(si[3], 7, 0, 1)];
+		*di++ = table[bits(si[3], 6, 4, 5)];
+		*di++ = table[bits(si[3], 1, 4, 2) | bits(si[4], 7, 2, 3)];
+		*di++ = table[bits(si[4], 4, 4, 5)];
+
+		si += 5;
+		n -= 5;
+	}
+
+	if(n >= 1) {
+		*di++ = table[bits(si[0], 7, 4, 5)];
+		carry = bits(si[0], 2, 4, 3);
+	}
+	if(n >= 2) {
+		*di++ = table[carry | bits(si[1], 7, 1, 2)];
+		*di++ = table[bits(si[1], 5, 4, 5)];
+		carry = bits(si[1], 0, 4, 1);
+	}
+	if(n >= 3) {
+		*di++ = table[carry | bits(si[2], 7, 3, 4)];
+		carry = bits(si[2], 3, 4, 4);
+	}
+	if(n >= 4) {
+		*di++ = table[carry | bits(si[3], 7, 0, 1)];
+		*di++ = table[bits(si[3], 6, 4, 5)];
+		carry = bits(si[3], 1, 4, 2);
+	}
+	if(n)
+		*di = table[carry];
+}
+
 size_t base32_encsize(
 		size_t n)
 {
@@ -70,72 +244,67 @@ void base32_enc(
 		const void *src,
 		size_t n)
 {
-	unsigned char carry;
-	const unsigned char *si = src;
-
-	while(n >= 5) {
-		*di++ = enc_table[bits(si[0], 7, 4, 5)];
-		*di++ = enc_table[bits(si[0], 2, 4, 3) | bits(si[1], 7, 1, 2)];
-		*di++ = enc_table[bits(si[1], 5, 4, 5)];
-		*di++ = enc_table[bits(si[1], 0, 4, 1) | bits(si[2], 7, 3, 4)];
-		*di++ = enc_table[bits(si[2], 3, 4, 4) | bits(si[3], 7, 0, 1)];
-		*di++ = enc_table[bits(si[3], 6, 4, 5)];
-		*di++ = enc_table[bits(si[3], 1, 4, 2) | bits(si[4], 7, 2, 3)];
-		*di++ = enc_table[bits(si[4], 4, 4, 5)];
-
-		si += 5;
-		n -= 5;
-	}
+	encode(di, src, n, enc_table);
+}
 
-	if(n >= 1) {
-		*di++ = enc_table[bits(si[0], 7, 4, 5)];
-		carry = bits(si[0], 2, 4, 3);
-	}
-	if(n >= 2) {
-		*di++ = enc_table[carry | bits(si[1], 7, 1, 2)];
-		*di++ = enc_table[bits(si[1], 5, 4, 5)];
-		carry = bits(si[1], 0, 4, 1);
-	}
-	if(n >= 3) {
-		*di++ = enc_table[carry | bits(si[2], 7, 3, 4)];
-		carry = bits(si[2], 3, 4, 4);
-	}
-	if(n >= 4) {
-		*di++ = enc_table[carry | bits(si[3], 7, 0, 1)];
-		*di++ = enc_table[bits(si[3], 6, 4, 5)];
-		carry = bits(si[3], 1, 4, 2);
-	}
-	if(n)
-		*di = enc_table[carry];
+void base32_enc_lower(
+		char *di,
+		const void *src,
+		size_t n)
+{
+	encode(di, src, n, enc_table_lower);
 }
 
-int base32_dec(
+int base32_decn(
 		void *dest,
-		const char *si)
+		const char *si,
+		size_t n)
 {
 	char *di = dest;
-	unsigned char block[8];
+	uint8_t block[8];
 	unsigned char tmp;
 	unsigned char carry = 0;
 	int bidx = 0;
 
-	while(*si > 0) {
-		tmp = dec_table[(int)*si];
-		if(tmp == 0xff) {
+#ifdef SIMD_WIDTH
+	uint8_t wide[SIMD_WIDTH];
+	int i;
+
+	while(n >= SIMD_WIDTH) {
+		if(!dec_simd(wide, si)) {
 			errno = EINVAL;
 			return -1;
 		}
+		for(i = 0; i < SIMD_WIDTH / 8; i++)
+			pack(di + 5 * i, wide + 8 * i);
+		di += SIMD_WIDTH / 8 * 5;
+		si += SIMD_WIDTH;
+		n -= SIMD_WIDTH;
+	}
+#endif
 
-		block[bidx++] = tmp;
-		if(bidx == 8) {
-			*di++ = bits(block[0], 4, 7, 5) | bits(block[1], 4, 2, 3);
-			*di++ = bits(block[1], 1, 7, 2) | bits(block[2], 4, 5, 5) | bits(block[3], 4, 0, 1);
-			*di++ = bits(block[3], 3, 7, 4) | bits(block[4], 4, 3, 4);
-			*di++ = bits(block[4], 0, 7, 1) | bits(block[5], 4, 6, 5) | bits(block[6], 4, 1, 2);
-			*di++ = bits(block[6], 2, 7, 3) | bits(block[7], 4, 4, 5);
-			bidx = 0;
+	while(n >= 8) {
+		for(bidx = 0; bidx < 8; bidx++) {
+			tmp = (unsigned char)si[bidx];
+			if(tmp >= 128 || dec_table[tmp] == 0xff) {
+				errno = EINVAL;
+				return -1;
+			}
+			block[bidx] = dec_table[tmp];
 		}
-		si++;
+		pack(di, block);
+		di += 5;
+		si += 8;
+		n -= 8;
+	}
+
+	for(bidx = 0; bidx < (int)n; bidx++) {
+		tmp = (unsigned char)si[bidx];
+		if(tmp >= 128 || dec_table[tmp] == 0xff) {
+			errno = EINVAL;
+			return -1;
+		}
+		block[bidx] = dec_table[tmp];
 	}
 	if(bidx >= 2) {
 		*di++ = bits(block[0], 4, 7, 5) | bits(block[1], 4, 2, 3);
@@ -161,3 +330,34 @@ int base32_dec(
 		return 0;
 }
 
+int base32_dec(
+		void *dest,
+		const char *si)
+{
+	return base32_decn(dest, si, strlen(si));
+}
+
+size_t base32_dec_batch(
+		void *dest,
+		size_t *destoff,
+		const char *src,
+		const size_t *srcoff,
+		size_t n)
+{
+	char *di = dest;
+	size_t failed = 0;
+	size_t off = 0;
+	ssize_t len;
+	size_t i;
+
+	for(i = 0; i < n; i++) {
+		destoff[i] = off;
+		len = base32_decsize(srcoff[i + 1] - srcoff[i]);
+		if(len < 0 || base32_decn(di + off, src + srcoff[i], srcoff[i + 1] - srcoff[i]) < 0)
+			failed++;
+		else
+			off += len;
+	}
+	destoff[n] = off;
+	return failed;
+}
@@ -20,10 +20,32 @@ void base32_enc(
 		const void *src,
 		size_t n);
 
+/* same as base32_enc(), but emits lower case letters */
+void base32_enc_lower(
+		char *dest,
+		const void *src,
+		size_t n);
+
+/* decoding accepts upper and lower case letters */
 int base32_dec(
 		void *dest,
 		const char *si);
 
+int base32_decn(
+		void *dest,
+		const char *si,
+		size_t n);
+
+/* decodes n strings; string i is src[srcoff[i]..srcoff[i + 1]) and is written to
+ * dest[destoff[i]..destoff[i + 1]). dest must hold (srcoff[n] - srcoff[0]) * 5 / 8 bytes.
+ * invalid strings decode to an empty range; returns the number of invalid strings. */
+size_t base32_dec_batch(
+		void *dest,
+		size_t *destoff,
+		const char *src,
+		const size_t *srcoff,
+		size_t n);
+
 #ifdef __cplusplus
 }
 #endif
@@ -88,6 +88,9 @@ CentralWidget::CentralWidget(QString dirname, MainWindow *parent)
 		_ui.splitter->setSizes({ 5, 10 });
 	}
 
+	dirFrontend->setLazy(settings.value("lazyLoading", true).toBool());
+	dirFrontend->setMemoryBudget(settings.value("memoryBudget", 0).toULongLong() * 1024 * 1024);
+	dirFrontend->setJournaled(settings.value("journaled", true).toBool());
 	dirFrontend->load();
 
 	unsigned int presetLang = settings.value("presetLanguage").toUInt();
@@ -128,6 +131,11 @@ CentralWidget::~CentralWidget() {
 	for (i = _ui.treeWidget->topLevelItemCount() - 1; _ui.treeWidget->topLevelItemCount(); --i) {
 		delete _ui.treeWidget->takeTopLevelItem(i);
 	}
+	try {
+		static_cast<curspec::DirFrontend*>(_treeItemContext.frontend)->flush();
+	} catch (const Exception &ex) {
+		qInfo() << "exception:" << ex.message(); //changes stay in the journal and are replayed on next load
+	}
 	delete _treeItemContext.frontend;
 	delete _treeItemContext.saveState;
 }
@@ -378,6 +378,9 @@ EditForm::EditForm(TreeItemContext *context, DataItem *item, curspec::LanguageId
 	} else if (item->declKey == &curspec::textLetter) {
 		keyEd.select(&curspec::textContent);
 		keyEd.uintPut(curspec::TextContent::LetterId, item->id());
+		// keep letter data resident while the form holds pointers into it
+		_pinKey = keyEd;
+		_context->frontend->pin(_pinKey);
 		curspec::TextAnnotated *value = _context->frontend->get<curspec::TextAnnotated>(keyEd);
 		if (value) {
 			QSplitter *splitter = new QSplitter();
@@ -385,6 +388,7 @@ EditForm::EditForm(TreeItemContext *context, DataItem *item, curspec::LanguageId
 			_contentEdit = new ContentEdit(_context, keyEd, value, this);
 			_contentEdit->setContextMenuPolicy(Qt::CustomContextMenu);
 			connect(_contentEdit,SIGNAL(customContextMenuRequested(const QPoint&)), this, SLOT(annContextMenu(const QPoint &)));
+			connect(_contentEdit, SIGNAL(rebased(const QList<quint32> &)), this, SLOT(contentRebased(const QList<quint32> &)));
 			splitter->addWidget(_contentEdit);
 			_tabWidget = new QTabWidget(this);
 			_tabWidget->setTabPosition(QTabWidget::West);
@@ -465,6 +469,13 @@ EditForm::EditForm(TreeItemContext *context, DataItem *item, curspec::LanguageId
 	}
 }
 
+EditForm::~EditForm()
+{
+	if (!_pinKey.isEmpty()) {
+		_context->frontend->unpin(_pinKey);
+	}
+}
+
 void EditForm::changesMade()
 {
 	_changesMade = true;
@@ -510,3 +521,22 @@ void EditForm::annContextMenu(const QPoint &point)
 		}
 	}
 }
+
+void EditForm::contentRebased(const QList<quint32> &lost)
+{
+	for (int i = 0; i < _tabWidget->count(); i++) {
+		CategoryEdit *ce = dynamic_cast<CategoryEdit *>(_tabWidget->widget(i));
+		if (ce) {
+			ce->reloadComments();
+		}
+	}
+	if (!lost.isEmpty()) {
+		QStringList ids;
+		for (auto id : lost) {
+			ids.append(QString::number(id));
+		}
+		qInfo() << "annotations with deleted anchor words:" << ids.join(", ");
+		_context->mainWindow->statusBar()->showMessage(QString::number(lost.size()) + " annotation(s) lost their anchor words and were moved, please check", 5000);
+	}
+	this->changesMade();
+}
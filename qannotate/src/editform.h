@@ -37,6 +37,7 @@ class EditForm : public QWidget {
 	Q_OBJECT
 	public:
 		EditForm(TreeItemContext *context, DataItem *item, curspec::LanguageId langId);
+		~EditForm();
 
 		DataItem *item() {return _item;}
 		curspec::LanguageId langId() {return _langId;}
@@ -46,6 +47,7 @@ class EditForm : public QWidget {
 	public slots:
 		void tabChanged(int index);
 		void annContextMenu(const QPoint &);
+		void contentRebased(const QList<quint32> &lost);
 
 	private:
 		DataItem *_item;
@@ -55,5 +57,6 @@ class EditForm : public QWidget {
 		TranslationEditForm *_translationEditForm;
 		ContentEdit *_contentEdit;
 		QTabWidget *_tabWidget;
+		QByteArray _pinKey;
 		bool _changesMade;
 };
@@ -397,8 +397,42 @@ void ContentEdit::finished()
 	curspec::TextAnnotated *value = _context->frontend->get<curspec::TextAnnotated>(_propertyKey, true);
 	if (value) {
 		QStringList plainText = this->toPlainText().split("\n");
-		 trimList(plainText);
-		 value->text = plainText;
+		trimList(plainText);
+		value->text = plainText;
+
+		TextFragmenter *fragmenter = new TextFragmenter(plainText.join("\n"));
+		if (fragmenter->text() == textFragmenter->text()) {
+			delete fragmenter;
+			return;
+		}
+		// move annotations to the new word coordinates; only those at or behind the edit are touched
+		TextRebaser rebaser(*textFragmenter, *fragmenter);
+		QList<quint32> lost;
+		for (auto &comment : value->comments) {
+			if (!rebaser.affected(comment.pend, comment.wend)) {
+				continue;
+			}
+			int pbegin = comment.pbegin;
+			int wbegin = comment.wbegin;
+			int pend = comment.pend;
+			int wend = comment.wend;
+			bool kept = rebaser.map(&pbegin, &wbegin, TextRebaser::AnchorBegin);
+			kept = rebaser.map(&pend, &wend, TextRebaser::AnchorEnd) && kept;
+			if (pbegin > pend || (pbegin == pend && wbegin > wend)) {
+				pend = pbegin;
+				wend = wbegin;
+			}
+			comment.pbegin = pbegin;
+			comment.wbegin = wbegin;
+			comment.pend = pend;
+			comment.wend = wend;
+			if (!kept) {
+				lost.append(comment.id);
+			}
+		}
+		delete textFragmenter;
+		textFragmenter = fragmenter;
+		emit rebased(lost);
 	}
 }
 
@@ -503,6 +537,22 @@ void CategoryEdit::markInit()
 	this->valueChanged(0);
 }
 
+void CategoryEdit::reloadComments()
+{
+	for (auto commentItem : _comments) {
+		delete commentItem;
+	}
+	_comments.clear();
+	for (auto comment : _value->comments) {
+		if (comment.type == _annotatedType) {
+			CommentItem *commentItem = new CommentItem(_contentEdit, comment.pbegin, comment.wbegin, comment.pend, comment.wend, comment.punc, comment.id);
+			_comments.append(commentItem);
+		}
+	}
+	std::sort(_comments.begin(), _comments.end(), [](const CommentItem *a, const CommentItem *b) { return *a < *b; });
+	_slider->setMaximum(_comments.size() - 1);
+}
+
 void CategoryEdit::anchorClicked(const QUrl &link)
 {
 	QStringList linkParts = link.path().split(";");
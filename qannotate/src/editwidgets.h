@@ -112,6 +112,9 @@ class ContentEdit : public QTextBrowser {
 		void reload();
 		QByteArray propertyKey() {return _propertyKey;}
 
+	signals:
+		void rebased(const QList<quint32> &lost);
+
 	private:
 		TreeItemContext *_context;
 		QByteArray _propertyKey;
@@ -130,6 +133,7 @@ class CategoryEdit : public QWidget {
 		CategoryEdit(TreeItemContext *context, EditForm *editForm, ContentEdit *annTextEdit, curspec::TextAnnotated *value, quint8 annotatedType, QByteArray key);
 
 		void markInit();
+		void reloadComments();
 		void contextMenu(const QPoint &point);
 
 	public slots:
@@ -44,6 +44,13 @@ SettingsDialog::SettingsDialog(QWidget *parent)
 	_initButton->setEnabled(false);
 	hLt3->addWidget(_initButton);
 	fLt1->addRow("Directory Info:", hLt3);
+	_lazyBox = new QCheckBox("Load letters on demand (takes effect on next open)", this);
+	fLt1->addRow("", _lazyBox);
+	_budgetSpinBox = new QSpinBox(this);
+	_budgetSpinBox->setRange(0, 65536);
+	_budgetSpinBox->setSuffix(" MB");
+	_budgetSpinBox->setSpecialValueText("unlimited");
+	fLt1->addRow("Letter Memory:", _budgetSpinBox);
 	vLt1->addLayout(fLt1);
 	_clearBox = new QCheckBox("Clear settings before", this);
 	vLt1->addWidget(_clearBox);
@@ -64,6 +71,10 @@ SettingsDialog::SettingsDialog(QWidget *parent)
 		presetLang = 0;
 	}
 	_langComboBox->setCurrentIndex(presetLang);
+	_lazyBox->setChecked(_settings.value("lazyLoading", true).toBool());
+	_budgetSpinBox->setValue(_settings.value("memoryBudget", 0).toInt());
+	_budgetSpinBox->setEnabled(_lazyBox->isChecked());
+	connect(_lazyBox, SIGNAL(toggled(bool)), _budgetSpinBox, SLOT(setEnabled(bool)));
 
 	_iniFile = new IniFile(_settings.value("presetDirectory").toString());
 	_dirLineEdit->setText(_iniFile->dirName());
@@ -116,5 +127,7 @@ void SettingsDialog::saveSettings()
 		_settings.setValue("presetDirectory", presetDir);
 	}
 	_settings.setValue("presetLanguage", _langComboBox->currentIndex());
+	_settings.setValue("lazyLoading", _lazyBox->isChecked());
+	_settings.setValue("memoryBudget", _budgetSpinBox->value());
 	this->accept();
 }
@@ -5,6 +5,7 @@
 #include <QComboBox>
 #include <QPushButton>
 #include <QCheckBox>
+#include <QSpinBox>
 #include <QLineEdit>
 #include <QLabel>
 
@@ -32,5 +33,7 @@ class SettingsDialog : public QDialog {
 		QPushButton *_okButton;
 		QPushButton *_cancelButton;
 		QCheckBox *_clearBox;
+		QCheckBox *_lazyBox;
+		QSpinBox *_budgetSpinBox;
 		IniFile *_iniFile;
 };
\ No newline at end of file
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <QHash>
+#include <QSet>
+
 #include "../src/frontend.h"
+#include "../src/dirscan.h"
 
 namespace spec { namespace v1_0 {
 	class DirFrontend : public AbstractDirFrontend {
@@ -12,15 +16,21 @@ namespace spec { namespace v1_0 {
 			virtual void actionSave() override;
 			virtual void actionErase(const QByteArray &key, Value *value) override;
 			virtual void actionModify(const QByteArray &key, Value *value) override;
+			virtual void actionFault(const QByteArray &prefix) override;
+			virtual quint64 actionGroup(const QByteArray &key) override;
+			virtual void actionEvict(quint64 group) override;
 
 		private:
-			void loadPersons();
-			void loadLocations();
-			void loadBibliography();
-			void loadPhilComments();
-			void loadHistComments();
-			void loadLetters();
-			void loadIntro();
+			//tree: listing of the whole database directory, see DirScanner::scan()
+			void loadPersons(const DirScanner::Tree &tree);
+			void loadLocations(const DirScanner::Tree &tree);
+			void loadBibliography(const DirScanner::Tree &tree);
+			void loadPhilComments(const DirScanner::Tree &tree);
+			void loadHistComments(const DirScanner::Tree &tree);
+			void loadLetters(const DirScanner::Tree &tree);
+			size_t loadLetter(quint64 letid, const DirHandle &ldir, const QStringList &files); //files: regular files in 'ldir'; returns approximate number of bytes loaded
+			void loadUnloaded(quint64 letid);
+			void loadIntro(const DirScanner::Tree &tree);
 			void storePerson(const QString &name, quint64 id, bool create = true);
 			void storeLocation(LocationType type, const QString &name, quint64 id, bool create = true);
 			void storeBibliography(BibliographyType type, const QString &name, quint64 id, bool create = true);
@@ -29,11 +39,14 @@ namespace spec { namespace v1_0 {
 			void storeLetter(quint64 book, quint64 letter, quint64 id, bool create = true);
 			void storeIntro(const QString &name, quint64 id, bool create = true);
 
-			QDir categoryDir(const QString &category, bool *exist); //exist: input: if true, dir will be created; output: if input is false, output indicates, whether dir exists
-			QDir categoryDir(const QStringList &category, bool *exist); //exist: input: if true, dir will be created; output: if input is false, output indicates, whether dir exists
-			QDir letterDir(quint64 book, quint64 letter, bool *exist);
+			DirHandle dirHandle(const QString &path, bool create); //cached handle of 'path' (relative to rootdir()); if it does not exist: created if 'create' is true, otherwise an invalid handle is returned
+			void dropDirHandles(const QString &path); //forget cached handles of 'path' and its subdirectories; after removing 'path'
+			QString idPath(const QString &dir, const QString &filename) const; //path of an object file in the persistent id map; 'dir' is relative to rootdir()
 
 			QMap<quint64, quint64> _id2number;
+			QHash<quint64, QString> _letterDirs; //[letter id] -> letter directory, relative to rootdir()
+			QHash<QString, DirHandle> _dirHandles; //see dirHandle()
+			QSet<quint64> _unloaded; //lazy mode: letter ids, whose contents are not loaded
 	};
 }}
 
@@ -1,3 +1,4 @@
+#include <QFileInfo>
 #include <QRegularExpression>
 #include <functional>
 #include <QTextStream>
@@ -196,93 +197,92 @@ namespace spec { namespace v1_0 {
 #endif
 	}
 
+	static const int MaxDirHandles = 256; //bound for DirFrontend::_dirHandles
+
+	//paths of objects in the persistent id map; numbers are normalized, so they do not depend on the directory names
+	static QString bookPath(quint64 book)
+	{
+		return QString("letter/%1").arg(book);
+	}
+
+	static QString letterPath(quint64 book, quint64 letter)
+	{
+		return QString("letter/%1/%2").arg(book).arg(letter);
+	}
+
+	//seen: number of markups per anchor so far; disambiguates markups of the same range
+	static QString markupPath(const QString &letter, const char *type, quint64 pbegin, quint64 wbegin, quint64 pend, quint64 wend, QHash<QString, int> *seen)
+	{
+		QString anchor = QString("p%1w%2-p%3w%4").arg(pbegin).arg(wbegin).arg(pend).arg(wend);
+		return QString("%1/%2/%3.%4").arg(letter, type, anchor).arg((*seen)[anchor]++);
+	}
+
 	DirFrontend::DirFrontend(const QDir &root)
 		:	AbstractDirFrontend(&meta, root)
 	{}
 
-	QDir DirFrontend::categoryDir(const QString &category, bool *exmk)
+	QString DirFrontend::idPath(const QString &dir, const QString &filename) const
 	{
-		QDir dir = rootdir();
-		if(!dir.cd(category)) {
-			if(!*exmk)
-				return dir;
-			else if(!dir.mkdir(category))
-				throw FrontendException("Error creating category subdir");
-			else if(!dir.cd(category))
-				throw FrontendException("Error entering category subdir");
-		}
-		*exmk = true;
-		return dir;
+		return dir + '/' + filename;
 	}
 
-	QDir DirFrontend::categoryDir(const QStringList &category, bool *exmk)
+	DirHandle DirFrontend::dirHandle(const QString &path, bool create)
 	{
-		QDir dir = rootdir();
-		for(auto it : category) {
-			if(!dir.cd(it)) {
-				if(!*exmk)
-					return dir;
-				else if(!dir.mkdir(it))
-					throw FrontendException("Error creating category subdir");
-				else if(!dir.cd(it))
-					throw FrontendException("Error entering category subdir");
+		auto it = _dirHandles.constFind(path);
+		if(it != _dirHandles.constEnd())
+			return *it;
+		DirHandle dir;
+		if(path.isEmpty())
+			dir = DirHandle(rootdir().absolutePath());
+		else {
+			int sep = path.lastIndexOf('/');
+			QString name = path.mid(sep + 1);
+			DirHandle parent = dirHandle(sep < 0 ? QString() : path.left(sep), create);
+			dir = parent.child(name);
+			if(!dir.isValid() && create) {
+				parent.mkdir(name);
+				dir = parent.child(name);
+				if(!dir.isValid())
+					throw FrontendException("Error creating subdir");
 			}
 		}
-		*exmk = true;
+		if(!dir.isValid())
+			return dir;
+		if(_dirHandles.size() >= MaxDirHandles) //every handle holds a descriptor; handles in use elsewhere stay valid
+			_dirHandles.clear();
+		_dirHandles.insert(path, dir);
 		return dir;
 	}
 
-	QDir DirFrontend::letterDir(quint64 book, quint64 letter, bool *exmk)
+	void DirFrontend::dropDirHandles(const QString &path)
 	{
-		QDir dir = rootdir();
-		QString bookstr = QString("%1").arg(book);
-		QString letstr = QString("%1").arg(letter);
-		if(!dir.cd("letter")) {
-			if(!*exmk)
-				return dir;
-			else if(!dir.mkdir("letter"))
-				throw FrontendException("Error creating letter subdir");
-			else if(!dir.cd("letter"))
-				throw FrontendException("Error entering letter subdir");
-		}
-		if(!dir.cd(bookstr)) {
-			if(!*exmk)
-				return dir;
-			else if(!dir.mkdir(bookstr))
-				throw FrontendException("Error creating book subdir");
-			else if(!dir.cd(bookstr))
-				throw FrontendException("Error entering book subdir");
-		}
-		if(!dir.cd(letstr)) {
-			if(!*exmk)
-				return dir;
-			else if(!dir.mkdir(letstr))
-				throw FrontendException("Error creating letter subdir");
-			else if(!dir.cd(letstr))
-				throw FrontendException("Error entering letter subdir");
-		}
-		*exmk = true;
-		return dir;
+		QString prefix = path + '/';
+		for(auto it = _dirHandles.begin(); it != _dirHandles.end();)
+			if(it.key() == path || it.key().startsWith(prefix))
+				it = _dirHandles.erase(it);
+			else
+				++it;
 	}
 
-	void DirFrontend::loadPersons()
+	void DirFrontend::loadPersons(const DirScanner::Tree &tree)
 	{
-		bool exmk = false;
-		QDir dir = categoryDir("person", &exmk);
-		if(!exmk)
+		auto listing = tree.constFind("person");
+		if(listing == tree.constEnd())
 			return;
-		QStringList entries = dir.entryList(QDir::Files);
+		DirHandle dir = dirHandle(listing->path, false);
+		const QStringList &entries = listing->files;
+		QStringList names = decodeFilenames(entries);
 		KeyEditor clsed(&personClass);
-		KeyEditor objed(&personObject);
-		for(auto it : entries) {
-			QFile file(dir.absoluteFilePath(it));
-			if(!file.open(QFile::ReadOnly))
+		KeyCodec<PersonObject> objkey;
+		for(int i = 0; i < entries.size(); i++) {
+			QFile file;
+			if(!dir.open(&file, entries.at(i), QFile::ReadOnly))
 				throw FrontendException("Error opening person file");
-			QString name = decodeFilename(it);
-			quint64 objid = acquire(&objectId);
+			QString name = names.at(i);
+			quint64 objid = acquire(&objectId, idPath(listing->path, encodeFilename(name)));
 			clsed.stringPut(PersonClass::ObjectName, name);
 			SyncFrontend::get<ObjectRef>(clsed, true)->id = objid;
-			objed.uintPut(PersonObject::ObjectId, objid);
+			objkey.objectId = objid;
 			parseProperties(&file, [&](const QString &name, const QString &language, const QStringList &text){
 				quint64 propid = EnumInfo<PersonPropertyId>::findString(name);
 				quint64 langid = EnumInfo<LanguageId>::findString(language);
@@ -290,10 +290,10 @@ namespace spec { namespace v1_0 {
 					throw FrontendException("No such property for person");
 				else if(!language.isNull() && !langid)
 					throw FrontendException("No such language for person property");
-				objed.uintPut(PersonObject::PropertyId, propid);
-				objed.uintPut(PersonObject::LanguageId, langid);
-				auto value = get(objed, true);
-				auto mapto = objed.mapto();
+				objkey.propertyId = propid;
+				objkey.languageId = langid;
+				auto value = SyncFrontend::get(objkey, true);
+				auto mapto = value->decl();
 				if(mapto == &textLine) {
 					if(text.size() == 1)
 						value->to<TextLine>()->text = text.at(0);
@@ -314,24 +314,25 @@ namespace spec { namespace v1_0 {
 		}
 	}
 
-	void DirFrontend::loadPhilComments()
+	void DirFrontend::loadPhilComments(const DirScanner::Tree &tree)
 	{
-		bool exmk = false;
-		QDir dir = categoryDir("phil-comment", &exmk);
-		if(!exmk)
+		auto listing = tree.constFind("phil-comment");
+		if(listing == tree.constEnd())
 			return;
-		QStringList entries = dir.entryList(QDir::Files);
+		DirHandle dir = dirHandle(listing->path, false);
+		const QStringList &entries = listing->files;
+		QStringList names = decodeFilenames(entries);
 		KeyEditor clsed(&philCommentClass);
-		KeyEditor objed(&philCommentObject);
-		for(auto it : entries) {
-			QFile file(dir.absoluteFilePath(it));
-			if(!file.open(QFile::ReadOnly))
+		KeyCodec<PhilCommentObject> objkey;
+		for(int i = 0; i < entries.size(); i++) {
+			QFile file;
+			if(!dir.open(&file, entries.at(i), QFile::ReadOnly))
 				throw FrontendException("Error opening philological comment file");
-			QString name = decodeFilename(it);
-			quint64 objid = acquire(&objectId);
+			QString name = names.at(i);
+			quint64 objid = acquire(&objectId, idPath(listing->path, encodeFilename(name)));
 			clsed.stringPut(PhilCommentClass::ObjectName, name);
 			SyncFrontend::get<ObjectRef>(clsed, true)->id = objid;
-			objed.uintPut(PhilCommentObject::ObjectId, objid);
+			objkey.objectId = objid;
 			parseProperties(&file, [&](const QString &name, const QString &language, const QStringList &text){
 				quint64 propid = EnumInfo<CommentPropertyId>::findString(name);
 				quint64 langid = EnumInfo<LanguageId>::findString(language);
@@ -339,10 +340,10 @@ namespace spec { namespace v1_0 {
 					throw FrontendException("No such property for person");
 				else if(!language.isNull() && !langid)
 					throw FrontendException("No such language for person property");
-				objed.uintPut(PhilCommentObject::PropertyId, propid);
-				objed.uintPut(PhilCommentObject::LanguageId, langid);
-				auto value = get(objed, true);
-				auto mapto = objed.mapto();
+				objkey.propertyId = propid;
+				objkey.languageId = langid;
+				auto value = SyncFrontend::get(objkey, true);
+				auto mapto = value->decl();
 				if(mapto == &textLine) {
 					if(text.size() == 1)
 						value->to<TextLine>()->text = text.at(0);
@@ -357,26 +358,27 @@ namespace spec { namespace v1_0 {
 		}
 	}
 
-	void DirFrontend::loadHistComments()
+	void DirFrontend::loadHistComments(const DirScanner::Tree &tree)
 	{
 		for(size_t i = 0; i < EnumInfo<HistCommentType>::N; i++) {
-			bool exmk = false;
-			QDir dir = categoryDir(QStringList({ "hist-comment", EnumInfo<HistCommentType>::name(i) }), &exmk);
-			if(!exmk)
+			auto listing = tree.constFind(QString("hist-comment/") + EnumInfo<HistCommentType>::name(i));
+			if(listing == tree.constEnd())
 				continue;
-			QStringList entries = dir.entryList(QDir::Files);
+			DirHandle dir = dirHandle(listing->path, false);
+			const QStringList &entries = listing->files;
+			QStringList names = decodeFilenames(entries);
 			KeyEditor clsed(&histCommentClass);
-			KeyEditor objed(&histCommentObject);
+			KeyCodec<HistCommentObject> objkey;
 			clsed.enumPut(HistCommentClass::Type, EnumInfo<HistCommentType>::fromIndex(i));
-			for(auto it : entries) {
-				QFile file(dir.absoluteFilePath(it));
-				if(!file.open(QFile::ReadOnly))
+			for(int j = 0; j < entries.size(); j++) {
+				QFile file;
+				if(!dir.open(&file, entries.at(j), QFile::ReadOnly))
 					throw FrontendException("Error opening historical comment file");
-				QString name = decodeFilename(it);
-				quint64 objid = acquire(&objectId);
+				QString name = names.at(j);
+				quint64 objid = acquire(&objectId, idPath(listing->path, encodeFilename(name)));
 				clsed.stringPut(HistCommentClass::ObjectName, name);
 				SyncFrontend::get<ObjectRef>(clsed, true)->id = objid;
-				objed.uintPut(HistCommentObject::ObjectId, objid);
+				objkey.objectId = objid;
 				parseProperties(&file, [&](const QString &name, const QString &language, const QStringList &text){
 					quint64 propid = EnumInfo<CommentPropertyId>::findString(name);
 					quint64 langid = EnumInfo<LanguageId>::findString(language);
@@ -384,10 +386,10 @@ namespace spec { namespace v1_0 {
 						throw FrontendException("No such property for person");
 					else if(!language.isNull() && !langid)
 						throw FrontendException("No such language for person property");
-					objed.uintPut(HistCommentObject::PropertyId, propid);
-					objed.uintPut(HistCommentObject::LanguageId, langid);
-					auto value = get(objed, true);
-					auto mapto = objed.mapto();
+					objkey.propertyId = propid;
+					objkey.languageId = langid;
+					auto value = SyncFrontend::get(objkey, true);
+					auto mapto = value->decl();
 					if(mapto == &textLine) {
 						if(text.size() == 1)
 							value->to<TextLine>()->text = text.at(0);
@@ -403,26 +405,27 @@ namespace spec { namespace v1_0 {
 		}
 	}
 
-	void DirFrontend::loadLocations()
+	void DirFrontend::loadLocations(const DirScanner::Tree &tree)
 	{
 		for(size_t i = 0; i < EnumInfo<LocationType>::N; i++) {
-			bool exmk = false;
-			QDir dir = categoryDir(QStringList({ "location", EnumInfo<LocationType>::name(i) }), &exmk);
-			if(!exmk)
+			auto listing = tree.constFind(QString("location/") + EnumInfo<LocationType>::name(i));
+			if(listing == tree.constEnd())
 				continue;
-			QStringList entries = dir.entryList(QDir::Files);
+			DirHandle dir = dirHandle(listing->path, false);
+			const QStringList &entries = listing->files;
+			QStringList names = decodeFilenames(entries);
 			KeyEditor clsed(&locationClass);
-			KeyEditor objed(&locationObject);
+			KeyCodec<LocationObject> objkey;
 			clsed.enumPut(LocationClass::Type, EnumInfo<LocationType>::fromIndex(i));
-			for(auto it : entries) {
-				QFile file(dir.absoluteFilePath(it));
-				if(!file.open(QFile::ReadOnly))
+			for(int j = 0; j < entries.size(); j++) {
+				QFile file;
+				if(!dir.open(&file, entries.at(j), QFile::ReadOnly))
 					throw FrontendException("Error opening location file");
-				QString name = decodeFilename(it);
-				quint64 objid = acquire(&objectId);
+				QString name = names.at(j);
+				quint64 objid = acquire(&objectId, idPath(listing->path, encodeFilename(name)));
 				clsed.stringPut(LocationClass::ObjectName, name);
 				SyncFrontend::get<ObjectRef>(clsed, true)->id = objid;
-				objed.uintPut(LocationObject::ObjectId, objid);
+				objkey.objectId = objid;
 				parseProperties(&file, [&](const QString &name, const QString &language, const QStringList &text){
 					quint64 propid = EnumInfo<LocationPropertyId>::findString(name);
 					quint64 langid = EnumInfo<LanguageId>::findString(language);
@@ -430,10 +433,10 @@ namespace spec { namespace v1_0 {
 						throw FrontendException("No such property for location");
 					else if(!language.isNull() && !langid)
 						throw FrontendException("No such language for location property");
-					objed.uintPut(LocationObject::PropertyId, propid);
-					objed.uintPut(LocationObject::LanguageId, langid);
-					auto value = get(objed, true);
-					auto mapto = objed.mapto();
+					objkey.propertyId = propid;
+					objkey.languageId = langid;
+					auto value = SyncFrontend::get(objkey, true);
+					auto mapto = value->decl();
 					if(mapto == &textLine) {
 						if(text.size() == 1)
 							value->to<TextLine>()->text = text.at(0);
@@ -449,26 +452,27 @@ namespace spec { namespace v1_0 {
 		}
 	}
 
-	void DirFrontend::loadBibliography()
+	void DirFrontend::loadBibliography(const DirScanner::Tree &tree)
 	{
 		for(size_t i = 0; i < EnumInfo<BibliographyType>::N; i++) {
-			bool exmk = false;
-			QDir dir = categoryDir(QStringList({ "bibliography", EnumInfo<BibliographyType>::name(i) }), &exmk);
-			if(!exmk)
+			auto listing = tree.constFind(QString("bibliography/") + EnumInfo<BibliographyType>::name(i));
+			if(listing == tree.constEnd())
 				continue;
-			QStringList entries = dir.entryList(QDir::Files);
+			DirHandle dir = dirHandle(listing->path, false);
+			const QStringList &entries = listing->files;
+			QStringList names = decodeFilenames(entries);
 			KeyEditor clsed(&bibliographyClass);
-			KeyEditor objed(&bibliographyObject);
+			KeyCodec<BibliographyObject> objkey;
 			clsed.enumPut(BibliographyClass::Type, EnumInfo<BibliographyType>::fromIndex(i));
-			for(auto it : entries) {
-				QFile file(dir.absoluteFilePath(it));
-				if(!file.open(QFile::ReadOnly))
+			for(int j = 0; j < entries.size(); j++) {
+				QFile file;
+				if(!dir.open(&file, entries.at(j), QFile::ReadOnly))
 					throw FrontendException("Error opening bibliography file");
-				QString name = decodeFilename(it);
-				quint64 objid = acquire(&objectId);
+				QString name = names.at(j);
+				quint64 objid = acquire(&objectId, idPath(listing->path, encodeFilename(name)));
 				clsed.stringPut(BibliographyClass::ObjectName, name);
 				SyncFrontend::get<ObjectRef>(clsed, true)->id = objid;
-				objed.uintPut(BibliographyObject::ObjectId, objid);
+				objkey.objectId = objid;
 				parseProperties(&file, [&](const QString &name, const QString &language, const QStringList &text){
 					quint64 propid = EnumInfo<BibliographyPropertyId>::findString(name);
 					quint64 langid = EnumInfo<LanguageId>::findString(language);
@@ -476,10 +480,10 @@ namespace spec { namespace v1_0 {
 						throw FrontendException("No such property for bibliography");
 					else if(!language.isNull() && !langid)
 						throw FrontendException("No such language for bibliography property");
-					objed.uintPut(BibliographyObject::PropertyId, propid);
-					objed.uintPut(BibliographyObject::LanguageId, langid);
-					auto value = get(objed, true);
-					auto mapto = objed.mapto();
+					objkey.propertyId = propid;
+					objkey.languageId = langid;
+					auto value = SyncFrontend::get(objkey, true);
+					auto mapto = value->decl();
 					if(mapto == &textLine) {
 						if(text.size() == 1)
 							value->to<TextLine>()->text = text.at(0);
@@ -495,166 +499,194 @@ namespace spec { namespace v1_0 {
 		}
 	}
 
-	void DirFrontend::loadLetters()
+	void DirFrontend::loadLetters(const DirScanner::Tree &tree)
 	{
-		bool exmk = false;
 		bool ok;
-		QDir dir = categoryDir("letter", &exmk);
-		if(!exmk)
+		auto listing = tree.constFind("letter");
+		if(listing == tree.constEnd())
 			return;
-		QStringList bookent = dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
 		KeyEditor booked(&textBook);
 		KeyEditor lettered(&textLetter);
-		KeyEditor contented(&textContent);
-		KeyEditor metaed(&textMetadata);
-		KeyEditor transed(&textTranslation);
-		KeyEditor commented(&textComment);
-		for(auto bit : bookent) {
+		for(auto bit : listing->dirs) {
 			quint64 booknum = bit.toULongLong(&ok, 10);
 			if(!ok)
 				throw FrontendException("invalid book: directory is not a valid number");
-			QDir bdir = dir;
-			if(!bdir.cd(bit))
+			auto book = tree.constFind(listing->path + '/' + bit);
+			if(book == tree.constEnd())
 				throw FrontendException("error descending into book directory");
+			DirHandle bdir;
+			if(!isLazy())
+				bdir = dirHandle(book->path, false);
 
-			quint64 bookid = acquire(&objectId);
+			quint64 bookid = acquire(&objectId, bookPath(booknum));
 			_id2number.insert(bookid, booknum);
 			booked.uintPut(TextBook::ObjectNumber, booknum);
 			lettered.uintPut(TextLetter::BookId, bookid);
 			SyncFrontend::get<ObjectRef>(booked, true)->id = bookid;
-			QStringList letterent = bdir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
-			for(auto lit : letterent) {
+			for(auto lit : book->dirs) {
 				quint64 letnum = lit.toULongLong(&ok, 10);
 				if(!ok)
 					throw FrontendException("invalid letter: directory is not a valid number");
-				quint64 letid = acquire(&objectId);
+				quint64 letid = acquire(&objectId, letterPath(booknum, letnum));
 				_id2number.insert(letid, letnum);
-				QDir ldir = bdir;
-				if(!ldir.cd(lit))
+				auto letter = tree.constFind(book->path + '/' + lit);
+				if(letter == tree.constEnd())
 					throw FrontendException("error descending into letter directory");
 				lettered.uintPut(TextLetter::ObjectNumber, letnum);
 				SyncFrontend::get<ObjectRef>(lettered, true)->id = letid;
-				contented.uintPut(TextContent::LetterId, letid);
-				transed.uintPut(TextTranslation::LetterId, letid);
-				metaed.uintPut(TextMetadata::LetterId, letid);
-				commented.uintPut(TextComment::LetterId, letid);
-				
-				{
-					QFile file(ldir.absoluteFilePath("metadata"));
-					if(file.open(QFile::ReadOnly)) {
-						parseProperties(&file, [&](const QString &name, const QString &language, const QStringList &text){
-							quint64 propid = EnumInfo<TextPropertyId>::findString(name);
-							quint64 langid = EnumInfo<LanguageId>::findString(language);
-							if(!propid)
-								throw FrontendException("No such property for letter");
-							else if(!language.isNull() && !langid)
-								throw FrontendException("No such language for letter property");
-							metaed.uintPut(TextMetadata::PropertyId, propid);
-							metaed.uintPut(TextMetadata::LanguageId, langid);
-							auto value = get(metaed, true);
-							auto mapto = metaed.mapto();
-							if(mapto == &textLine) {
-								if(text.size() == 1)
-									value->to<TextLine>()->text = text.at(0);
-								else if(text.size() > 1)
-									throw FrontendException("multiple lines of text for single-line text property for letter");
-							}
-							else if(mapto == &textMultiline)
-								value->to<TextMultiline>()->text = text;
-							else
-								throw FrontendException("(internal error) value type for person property not handled in spec-1.0.cpp");
-						});
-					}
-				}
+				_letterDirs.insert(letid, letter->path);
+				if(isLazy())
+					_unloaded.insert(letid);
+				else
+					loadLetter(letid, bdir.child(lit), letter->files);
+			}
+		}
+	}
 
-				{
-					QFile file(ldir.absoluteFilePath("translation"));
-					if(file.open(QFile::ReadOnly)) {
-						parseText(&file, [&](const QString &language, const QStringList &text){
-							quint64 langid = EnumInfo<LanguageId>::findString(language);
-							if(!language.isNull() && !langid)
-								throw FrontendException("No such language for letter translation");
-							transed.uintPut(TextTranslation::LanguageId, langid);
-							auto value = get(transed, true);
-							auto mapto = transed.mapto();
-							if(mapto == &textLine) {
-								if(text.size() == 1)
-									value->to<TextLine>()->text = text.at(0);
-								else if(text.size() > 1)
-									throw FrontendException("multiple lines of text for single-line text translation for letter");
-							}
-							else if(mapto == &textMultiline)
-								value->to<TextMultiline>()->text = text;
-							else
-								throw FrontendException("(internal error) value type for letter translation not handled in spec-1.0.cpp");
-						});
+	size_t DirFrontend::loadLetter(quint64 letid, const DirHandle &ldir, const QStringList &files)
+	{
+		size_t bytes = 0;
+		KeyCodec<TextContent> contentkey;
+		KeyCodec<TextMetadata> metakey;
+		KeyCodec<TextTranslation> transkey;
+		KeyCodec<TextComment> commentkey;
+		contentkey.letterId = letid;
+		transkey.letterId = letid;
+		metakey.letterId = letid;
+		commentkey.letterId = letid;
+		QFileInfo info(ldir.path());
+		QString lpath = letterPath(info.dir().dirName().toULongLong(), info.fileName().toULongLong());
+		
+		{
+			QFile file;
+			if(files.contains("metadata") && ldir.open(&file, "metadata", QFile::ReadOnly)) {
+				bytes += file.size() * sizeof(QChar);
+				parseProperties(&file, [&](const QString &name, const QString &language, const QStringList &text){
+					quint64 propid = EnumInfo<TextPropertyId>::findString(name);
+					quint64 langid = EnumInfo<LanguageId>::findString(language);
+					if(!propid)
+						throw FrontendException("No such property for letter");
+					else if(!language.isNull() && !langid)
+						throw FrontendException("No such language for letter property");
+					metakey.propertyId = propid;
+					metakey.languageId = langid;
+					auto value = SyncFrontend::get(metakey, true);
+					auto mapto = value->decl();
+					if(mapto == &textLine) {
+						if(text.size() == 1)
+							value->to<TextLine>()->text = text.at(0);
+						else if(text.size() > 1)
+							throw FrontendException("multiple lines of text for single-line text property for letter");
 					}
-				}
+					else if(mapto == &textMultiline)
+						value->to<TextMultiline>()->text = text;
+					else
+						throw FrontendException("(internal error) value type for person property not handled in spec-1.0.cpp");
+				});
+			}
+		}
 
-				auto content = SyncFrontend::get<TextAnnotated>(contented, true);
-
-				{
-					QFile file(ldir.absoluteFilePath("content"));
-					if(file.open(QFile::ReadOnly)) {
-						QTextStream stream(&file);
-						stream.setCodec("UTF-8");
-						for(;;) {
-							QString line = stream.readLine();
-							if(line.isNull())
-								break;
-							content->text.append(line);
-						}
+		{
+			QFile file;
+			if(files.contains("translation") && ldir.open(&file, "translation", QFile::ReadOnly)) {
+				bytes += file.size() * sizeof(QChar);
+				parseText(&file, [&](const QString &language, const QStringList &text){
+					quint64 langid = EnumInfo<LanguageId>::findString(language);
+					if(!language.isNull() && !langid)
+						throw FrontendException("No such language for letter translation");
+					transkey.languageId = langid;
+					auto value = SyncFrontend::get(transkey, true);
+					auto mapto = value->decl();
+					if(mapto == &textLine) {
+						if(text.size() == 1)
+							value->to<TextLine>()->text = text.at(0);
+						else if(text.size() > 1)
+							throw FrontendException("multiple lines of text for single-line text translation for letter");
 					}
+					else if(mapto == &textMultiline)
+						value->to<TextMultiline>()->text = text;
+					else
+						throw FrontendException("(internal error) value type for letter translation not handled in spec-1.0.cpp");
+				});
+			}
+		}
+
+		auto content = SyncFrontend::get<TextAnnotated>(contentkey, true);
+
+		{
+			QFile file;
+			if(files.contains("content") && ldir.open(&file, "content", QFile::ReadOnly)) {
+				bytes += file.size() * sizeof(QChar);
+				QTextStream stream(&file);
+				stream.setCodec("UTF-8");
+				for(;;) {
+					QString line = stream.readLine();
+					if(line.isNull())
+						break;
+					content->text.append(line);
 				}
+			}
+		}
 
-				for(size_t i = 0; i < annotatedType.nEnumValues; i++) {
-					QFile file(ldir.absoluteFilePath(annotatedType.enumValues[i].name));
-					if(file.open(QFile::ReadOnly)) {
-						parseMarkup(&file, [&](quint64 pbegin, quint64 wbegin, quint64 pend, quint64 wend, spec::v1_0::OptionPunc punc, const QMap<QString, QStringList> &text){
-							decltype(content->comments)::value_type markup;
-							markup.pbegin = pbegin;
-							markup.wbegin = wbegin;
-							markup.pend = pend;
-							markup.wend = wend;
-							markup.id = acquire(&objectId);
-							markup.punc = (quint8)punc;
-							markup.type = index2enum(i);
-							content->comments.append(markup);
-							for(auto it = text.begin(); it != text.end(); ++it) {
-								quint64 langid = EnumInfo<LanguageId>::findString(it.key());
-								if(!langid)
-									throw FrontendException("No such language for person property");
-								commented.uintPut(TextComment::ObjectId, markup.id);
-								commented.uintPut(TextComment::LanguageId, langid);
-								SyncFrontend::get<TextMultiline>(commented, true)->text = it.value();
-							}
-						});
+		for(size_t i = 0; i < annotatedType.nEnumValues; i++) {
+			QFile file;
+			if(files.contains(annotatedType.enumValues[i].name) && ldir.open(&file, annotatedType.enumValues[i].name, QFile::ReadOnly)) {
+				QHash<QString, int> seen;
+				bytes += file.size() * sizeof(QChar);
+				parseMarkup(&file, [&](quint64 pbegin, quint64 wbegin, quint64 pend, quint64 wend, spec::v1_0::OptionPunc punc, const QMap<QString, QStringList> &text){
+					decltype(content->comments)::value_type markup;
+					markup.pbegin = pbegin;
+					markup.wbegin = wbegin;
+					markup.pend = pend;
+					markup.wend = wend;
+					markup.id = acquire(&objectId, markupPath(lpath, annotatedType.enumValues[i].name, pbegin, wbegin, pend, wend, &seen));
+					markup.punc = (quint8)punc;
+					markup.type = index2enum(i);
+					content->comments.append(markup);
+					for(auto it = text.begin(); it != text.end(); ++it) {
+						quint64 langid = EnumInfo<LanguageId>::findString(it.key());
+						if(!langid)
+							throw FrontendException("No such language for person property");
+						commentkey.objectId = markup.id;
+						commentkey.languageId = langid;
+						SyncFrontend::get<TextMultiline>(commentkey, true)->text = it.value();
 					}
-				}
-				qSort(content->comments.begin(), content->comments.end(), commentLessThan);
+				});
 			}
 		}
-		QStringList entries = dir.entryList(QDir::Files);
+		qSort(content->comments.begin(), content->comments.end(), commentLessThan);
+		return bytes;
+	}
+
+	void DirFrontend::loadUnloaded(quint64 letid)
+	{
+		if(!_unloaded.remove(letid))
+			return;
+		DirHandle ldir = dirHandle(_letterDirs.value(letid), false);
+		QStringList files;
+		DirScanner::list(ldir, &files, nullptr);
+		groupLoaded(letid, loadLetter(letid, ldir, files));
 	}
 
-	void DirFrontend::loadIntro()
+	void DirFrontend::loadIntro(const DirScanner::Tree &tree)
 	{
-		bool exmk = false;
-		QDir dir = categoryDir("intro", &exmk);
-		if(!exmk)
+		auto listing = tree.constFind("intro");
+		if(listing == tree.constEnd())
 			return;
-		QStringList entries = dir.entryList(QDir::Files);
+		DirHandle dir = dirHandle(listing->path, false);
+		const QStringList &entries = listing->files;
+		QStringList names = decodeFilenames(entries);
 		KeyEditor clsed(&introClass);
-		KeyEditor objed(&introObject);
-		for(auto it : entries) {
-			QFile file(dir.absoluteFilePath(it));
-			if(!file.open(QFile::ReadOnly))
+		KeyCodec<IntroObject> objkey;
+		for(int i = 0; i < entries.size(); i++) {
+			QFile file;
+			if(!dir.open(&file, entries.at(i), QFile::ReadOnly))
 				throw FrontendException("Error opening intro file");
-			QString name = decodeFilename(it);
-			quint64 objid = acquire(&objectId);
+			QString name = names.at(i);
+			quint64 objid = acquire(&objectId, idPath(listing->path, encodeFilename(name)));
 			clsed.stringPut(IntroClass::ObjectName, name);
 			SyncFrontend::get<ObjectRef>(clsed, true)->id = objid;
-			objed.uintPut(IntroObject::ObjectId, objid);
+			objkey.objectId = objid;
 			parseProperties(&file, [&](const QString &name, const QString &language, const QStringList &text){
 				quint64 propid = EnumInfo<IntroPropertyId>::findString(name);
 				quint64 langid = EnumInfo<LanguageId>::findString(language);
@@ -662,10 +694,10 @@ namespace spec { namespace v1_0 {
 					throw FrontendException("No such property for intro");
 				else if(!language.isNull() && !langid)
 					throw FrontendException("No such language for intro property");
-				objed.uintPut(IntroObject::PropertyId, propid);
-				objed.uintPut(IntroObject::LanguageId, langid);
-				auto value = get(objed, true);
-				auto mapto = objed.mapto();
+				objkey.propertyId = propid;
+				objkey.languageId = langid;
+				auto value = SyncFrontend::get(objkey, true);
+				auto mapto = value->decl();
 				if(mapto == &textLine) {
 					if(text.size() == 1)
 						value->to<TextLine>()->text = text.at(0);
@@ -683,28 +715,30 @@ namespace spec { namespace v1_0 {
 
 	void DirFrontend::storePerson(const QString &name, quint64 id, bool create)
 	{
-		bool exmk = true;
-		QDir dir = categoryDir("person", &exmk);
+		QString path = "person";
+		DirHandle dir = dirHandle(path, true);
 		QString filename = encodeFilename(name);
-		QFile file(dir.absoluteFilePath(filename));
-		if(!create && !file.exists())
+		QFile file;
+		if(!create && !dir.exists(filename))
 			return;
-		else if(!file.open(QFile::WriteOnly))
+		else if(!dir.open(&file, filename, QFile::WriteOnly))
 			throw FrontendException("Error opening object file");
+		bindId(idPath(path, filename), id);
 		QTextStream stream(&file);
 		stream.setCodec("UTF-8");
-		KeyEditor ed(&meta);
-		ed.select(&personObject);
-		ed.uintPut(PersonObject::ObjectId, id);
-		size_t l = lower(ed);
-		size_t u = prefixUpper(ed);
+		KeyCodec<PersonObject> objkey;
+		objkey.objectId = id;
+		size_t l;
+		size_t u;
+		prefixRange(&l, &u, objkey, PersonObject::ObjectId);
 		for(; l < u; l++) {
-			ed.load(key(l));
-			QString name = enum2name(ed.enumGet<PersonPropertyId>(PersonObject::PropertyId));
-			const DeclValue *mapto = ed.mapto();
-			if(ed.uintGet(PersonObject::LanguageId)) {
+			if(!objkey.decode(key(l)))
+				throw FrontendException("(internal) invalid object key");
+			QString name = enum2name(EnumInfo<PersonPropertyId>::fromInt(objkey.propertyId));
+			const DeclValue *mapto = value(l)->decl();
+			if(objkey.languageId) {
 				QString language;
-				language = enum2name(ed.enumGet<LanguageId>(PersonObject::LanguageId));
+				language = enum2name(EnumInfo<LanguageId>::fromInt(objkey.languageId));
 				stream << name << " [" << language << "]:\n";
 			}
 			else
@@ -735,28 +769,30 @@ namespace spec { namespace v1_0 {
 
 	void DirFrontend::storeLocation(LocationType type, const QString &name, quint64 id, bool create)
 	{
-		bool exmk = true;
-		QDir dir = categoryDir(QStringList({ "location", EnumInfo<LocationType>::name(type) }), &exmk);
+		QString path = QString("location/") + EnumInfo<LocationType>::name(type);
+		DirHandle dir = dirHandle(path, true);
 		QString filename = encodeFilename(name);
-		QFile file(dir.absoluteFilePath(filename));
-		if(!create && !file.exists())
+		QFile file;
+		if(!create && !dir.exists(filename))
 			return;
-		else if(!file.open(QFile::WriteOnly))
+		else if(!dir.open(&file, filename, QFile::WriteOnly))
 			throw FrontendException("Error opening object file");
+		bindId(idPath(path, filename), id);
 		QTextStream stream(&file);
 		stream.setCodec("UTF-8");
-		KeyEditor ed(&meta);
-		ed.select(&locationObject);
-		ed.uintPut(LocationObject::ObjectId, id);
-		size_t l = lower(ed);
-		size_t u = prefixUpper(ed);
+		KeyCodec<LocationObject> objkey;
+		objkey.objectId = id;
+		size_t l;
+		size_t u;
+		prefixRange(&l, &u, objkey, LocationObject::ObjectId);
 		for(; l < u; l++) {
-			ed.load(key(l));
-			QString name = enum2name(ed.enumGet<LocationPropertyId>(LocationObject::PropertyId));
-			const DeclValue *mapto = ed.mapto();
-			if(ed.uintGet(LocationObject::LanguageId)) {
+			if(!objkey.decode(key(l)))
+				throw FrontendException("(internal) invalid object key");
+			QString name = enum2name(EnumInfo<LocationPropertyId>::fromInt(objkey.propertyId));
+			const DeclValue *mapto = value(l)->decl();
+			if(objkey.languageId) {
 				QString language;
-				language = enum2name(ed.enumGet<LanguageId>(LocationObject::LanguageId));
+				language = enum2name(EnumInfo<LanguageId>::fromInt(objkey.languageId));
 				stream << name << " [" << language << "]:\n";
 			}
 			else
@@ -780,28 +816,30 @@ namespace spec { namespace v1_0 {
 
 	void DirFrontend::storeBibliography(BibliographyType type, const QString &name, quint64 id, bool create)
 	{
-		bool exmk = true;
-		QDir dir = categoryDir(QStringList({ "bibliography", EnumInfo<BibliographyType>::name(type) }), &exmk);
+		QString path = QString("bibliography/") + EnumInfo<BibliographyType>::name(type);
+		DirHandle dir = dirHandle(path, true);
 		QString filename = encodeFilename(name);
-		QFile file(dir.absoluteFilePath(filename));
-		if(!create && !file.exists())
+		QFile file;
+		if(!create && !dir.exists(filename))
 			return;
-		else if(!file.open(QFile::WriteOnly))
+		else if(!dir.open(&file, filename, QFile::WriteOnly))
 			throw FrontendException("Error opening object file");
+		bindId(idPath(path, filename), id);
 		QTextStream stream(&file);
 		stream.setCodec("UTF-8");
-		KeyEditor ed(&meta);
-		ed.select(&bibliographyObject);
-		ed.uintPut(BibliographyObject::ObjectId, id);
-		size_t l = lower(ed);
-		size_t u = prefixUpper(ed);
+		KeyCodec<BibliographyObject> objkey;
+		objkey.objectId = id;
+		size_t l;
+		size_t u;
+		prefixRange(&l, &u, objkey, BibliographyObject::ObjectId);
 		for(; l < u; l++) {
-			ed.load(key(l));
-			QString name = enum2name(ed.enumGet<BibliographyPropertyId>(BibliographyObject::PropertyId));
-			const DeclValue *mapto = ed.mapto();
-			if(ed.uintGet(BibliographyObject::LanguageId)) {
+			if(!objkey.decode(key(l)))
+				throw FrontendException("(internal) invalid object key");
+			QString name = enum2name(EnumInfo<BibliographyPropertyId>::fromInt(objkey.propertyId));
+			const DeclValue *mapto = value(l)->decl();
+			if(objkey.languageId) {
 				QString language;
-				language = enum2name(ed.enumGet<LanguageId>(BibliographyObject::LanguageId));
+				language = enum2name(EnumInfo<LanguageId>::fromInt(objkey.languageId));
 				stream << name << " [" << language << "]:\n";
 			}
 			else
@@ -825,28 +863,30 @@ namespace spec { namespace v1_0 {
 
 	void DirFrontend::storePhilComment(const QString &name, quint64 id, bool create)
 	{
-		bool exmk = true;
-		QDir dir = categoryDir("phil-comment", &exmk);
+		QString path = "phil-comment";
+		DirHandle dir = dirHandle(path, true);
 		QString filename = encodeFilename(name);
-		QFile file(dir.absoluteFilePath(filename));
-		if(!create && !file.exists())
+		QFile file;
+		if(!create && !dir.exists(filename))
 			return;
-		else if(!file.open(QFile::WriteOnly))
+		else if(!dir.open(&file, filename, QFile::WriteOnly))
 			throw FrontendException("Error opening object file");
+		bindId(idPath(path, filename), id);
 		QTextStream stream(&file);
 		stream.setCodec("UTF-8");
-		KeyEditor ed(&meta);
-		ed.select(&philCommentObject);
-		ed.uintPut(PhilCommentObject::ObjectId, id);
-		size_t l = lower(ed);
-		size_t u = prefixUpper(ed);
+		KeyCodec<PhilCommentObject> objkey;
+		objkey.objectId = id;
+		size_t l;
+		size_t u;
+		prefixRange(&l, &u, objkey, PhilCommentObject::ObjectId);
 		for(; l < u; l++) {
-			ed.load(key(l));
-			QString name = enum2name(ed.enumGet<CommentPropertyId>(PhilCommentObject::PropertyId));
-			const DeclValue *mapto = ed.mapto();
-			if(ed.uintGet(PhilCommentObject::LanguageId)) {
+			if(!objkey.decode(key(l)))
+				throw FrontendException("(internal) invalid object key");
+			QString name = enum2name(EnumInfo<CommentPropertyId>::fromInt(objkey.propertyId));
+			const DeclValue *mapto = value(l)->decl();
+			if(objkey.languageId) {
 				QString language;
-				language = enum2name(ed.enumGet<LanguageId>(PhilCommentObject::LanguageId));
+				language = enum2name(EnumInfo<LanguageId>::fromInt(objkey.languageId));
 				stream << name << " [" << language << "]:\n";
 			}
 			else
@@ -870,28 +910,30 @@ namespace spec { namespace v1_0 {
 
 	void DirFrontend::storeHistComment(HistCommentType type, const QString &name, quint64 id, bool create)
 	{
-		bool exmk = true;
-		QDir dir = categoryDir(QStringList({ "hist-comment", EnumInfo<HistCommentType>::name(type) }), &exmk);
+		QString path = QString("hist-comment/") + EnumInfo<HistCommentType>::name(type);
+		DirHandle dir = dirHandle(path, true);
 		QString filename = encodeFilename(name);
-		QFile file(dir.absoluteFilePath(filename));
-		if(!create && !file.exists())
+		QFile file;
+		if(!create && !dir.exists(filename))
 			return;
-		else if(!file.open(QFile::WriteOnly))
+		else if(!dir.open(&file, filename, QFile::WriteOnly))
 			throw FrontendException("Error opening object file");
+		bindId(idPath(path, filename), id);
 		QTextStream stream(&file);
 		stream.setCodec("UTF-8");
-		KeyEditor ed(&meta);
-		ed.select(&histCommentObject);
-		ed.uintPut(HistCommentObject::ObjectId, id);
-		size_t l = lower(ed);
-		size_t u = prefixUpper(ed);
+		KeyCodec<HistCommentObject> objkey;
+		objkey.objectId = id;
+		size_t l;
+		size_t u;
+		prefixRange(&l, &u, objkey, HistCommentObject::ObjectId);
 		for(; l < u; l++) {
-			ed.load(key(l));
-			QString name = enum2name(ed.enumGet<CommentPropertyId>(HistCommentObject::PropertyId));
-			const DeclValue *mapto = ed.mapto();
-			if(ed.uintGet(HistCommentObject::LanguageId)) {
+			if(!objkey.decode(key(l)))
+				throw FrontendException("(internal) invalid object key");
+			QString name = enum2name(EnumInfo<CommentPropertyId>::fromInt(objkey.propertyId));
+			const DeclValue *mapto = value(l)->decl();
+			if(objkey.languageId) {
 				QString language;
-				language = enum2name(ed.enumGet<LanguageId>(HistCommentObject::LanguageId));
+				language = enum2name(EnumInfo<LanguageId>::fromInt(objkey.languageId));
 				stream << name << " [" << language << "]:\n";
 			}
 			else
@@ -915,22 +957,26 @@ namespace spec { namespace v1_0 {
 
 	void DirFrontend::storeLetter(quint64 book, quint64 letter, quint64 id, bool create)
 	{
-		bool exmk = true;
-		QDir dir = letterDir(book, letter, &exmk);
+		QString lpath = letterPath(book, letter);
+		bindId(lpath, id);
+		if(_unloaded.contains(id)) //not loaded, so unchanged
+			return;
 
-		KeyEditor ed(&meta);
-		ed.select(&textContent);
-		ed.uintPut(TextContent::LetterId, id);
-		auto content = SyncFrontend::get<TextAnnotated>(ed);
+		DirHandle dir = dirHandle(lpath, true); //the directory layout matches the id map paths
+		_letterDirs.insert(id, lpath);
+
+		KeyCodec<TextContent> contentkey;
+		contentkey.letterId = id;
+		auto content = SyncFrontend::get<TextAnnotated>(contentkey);
 		if(!content)
 			return;
 
 		qSort(content->comments.begin(), content->comments.end(), commentLessThan);
 
 		{
-			QFile file(dir.absoluteFilePath("content"));
-			if(file.exists() || create) {
-				if(!file.open(QFile::WriteOnly))
+			QFile file;
+			if(create || dir.exists("content")) {
+				if(!dir.open(&file, "content", QFile::WriteOnly))
 					throw FrontendException("Error opening letter content file");
 				QTextStream stream(&file);
 				stream.setCodec("UTF-8");
@@ -940,23 +986,25 @@ namespace spec { namespace v1_0 {
 		}
 
 		{
-			QFile file(dir.absoluteFilePath("metadata"));
-			if(file.exists() || create) {
-				if(!file.open(QFile::WriteOnly))
+			QFile file;
+			if(create || dir.exists("metadata")) {
+				if(!dir.open(&file, "metadata", QFile::WriteOnly))
 					throw FrontendException("Error opening letter metadata file");
 				QTextStream stream(&file);
 				stream.setCodec("UTF-8");
-				ed.select(&textMetadata);
-				ed.uintPut(TextMetadata::LetterId, id);
-				size_t l = lower(ed);
-				size_t u = prefixUpper(ed);
+				KeyCodec<TextMetadata> metakey;
+				metakey.letterId = id;
+				size_t l;
+				size_t u;
+				prefixRange(&l, &u, metakey, TextMetadata::LetterId);
 				for(; l < u; l++) {
-					ed.load(key(l));
-					QString name = enum2name(ed.enumGet<TextPropertyId>(TextMetadata::PropertyId));
-					const DeclValue *mapto = ed.mapto();
-					if(ed.uintGet(TextMetadata::LanguageId)) {
+					if(!metakey.decode(key(l)))
+						throw FrontendException("(internal) invalid letter metadata key");
+					QString name = enum2name(EnumInfo<TextPropertyId>::fromInt(metakey.propertyId));
+					const DeclValue *mapto = value(l)->decl();
+					if(metakey.languageId) {
 						QString language;
-						language = enum2name(ed.enumGet<LanguageId>(TextMetadata::LanguageId));
+						language = enum2name(EnumInfo<LanguageId>::fromInt(metakey.languageId));
 						stream << name << " [" << language << "]:\n";
 					}
 					else
@@ -980,22 +1028,24 @@ namespace spec { namespace v1_0 {
 		}
 
 		{
-			QFile file(dir.absoluteFilePath("translation"));
-			if(file.exists() || create) {
-				if(!file.open(QFile::WriteOnly))
+			QFile file;
+			if(create || dir.exists("translation")) {
+				if(!dir.open(&file, "translation", QFile::WriteOnly))
 					throw FrontendException("Error opening letter translation file");
 				QTextStream stream(&file);
 				stream.setCodec("UTF-8");
-				ed.select(&textTranslation);
-				ed.uintPut(TextTranslation::LetterId, id);
-				size_t l = lower(ed);
-				size_t u = prefixUpper(ed);
+				KeyCodec<TextTranslation> transkey;
+				transkey.letterId = id;
+				size_t l;
+				size_t u;
+				prefixRange(&l, &u, transkey, TextTranslation::LetterId);
 				for(; l < u; l++) {
-					ed.load(key(l));
-					const DeclValue *mapto = ed.mapto();
-					if(ed.uintGet(TextTranslation::LanguageId)) {
+					if(!transkey.decode(key(l)))
+						throw FrontendException("(internal) invalid letter translation key");
+					const DeclValue *mapto = value(l)->decl();
+					if(transkey.languageId) {
 						QString language;
-						language = enum2name(ed.enumGet<LanguageId>(TextTranslation::LanguageId));
+						language = enum2name(EnumInfo<LanguageId>::fromInt(transkey.languageId));
 						stream << "[" << language << "]:\n";
 					}
 					else
@@ -1018,22 +1068,24 @@ namespace spec { namespace v1_0 {
 			}
 		}
 
-		KeyEditor ced(&meta);
+		KeyCodec<TextComment> commentkey;
+		commentkey.letterId = id;
 		for(size_t i = 0; i < annotatedType.nEnumValues; i++) {
-			QFile file(dir.absoluteFilePath(annotatedType.enumValues[i].name));
-			if(file.exists() || create) {
-				if(!file.open(QFile::WriteOnly))
+			QFile file;
+			if(create || dir.exists(annotatedType.enumValues[i].name)) {
+				if(!dir.open(&file, annotatedType.enumValues[i].name, QFile::WriteOnly))
 					throw FrontendException("Error opening letter comment file");
 				QTextStream stream(&file);
 				stream.setCodec("UTF-8");
+				QHash<QString, int> seen;
+				unbindId(QString("%1/%2").arg(lpath, annotatedType.enumValues[i].name), true);
 				for(auto it : content->comments) {
 					if(EnumInfo<AnnotatedType>::fromInt(it.type) == EnumInfo<AnnotatedType>::fromIndex(i)) {
-						ced.select(&textComment);
-						ced.uintPut(TextComment::LetterId, id);
-						//ced.truncate(TextComment::LanguageId);
-						ced.uintPut(TextComment::ObjectId, it.id);
-						size_t cl = lower(ced);
-						size_t cu = prefixUpper(ced);
+						bindId(markupPath(lpath, annotatedType.enumValues[i].name, it.pbegin, it.wbegin, it.pend, it.wend, &seen), it.id);
+						size_t cl;
+						size_t cu;
+						commentkey.objectId = it.id;
+						prefixRange(&cl, &cu, commentkey, TextComment::ObjectId);
 						if(it.pbegin == it.pend && it.wbegin == it.wend)
 							stream << "@p" << it.pbegin << "w" << it.wbegin;
 						else
@@ -1044,8 +1096,9 @@ namespace spec { namespace v1_0 {
 							stream << "|.";
 						stream << ":\n";
 						for(; cl < cu; cl++) {
-							ced.load(key(cl));
-							QString language = enum2name(ced.enumGet<LanguageId>(TextComment::LanguageId));
+							if(!commentkey.decode(key(cl)))
+								throw FrontendException("(internal) invalid letter comment key");
+							QString language = enum2name(EnumInfo<LanguageId>::fromInt(commentkey.languageId));
 							stream << "\t[" << language << "]\n";
 							auto comment = SyncFrontend::value<TextMultiline>(cl);
 							for(auto it : comment->text)
@@ -1055,32 +1108,35 @@ namespace spec { namespace v1_0 {
 				}
 			}
 		}
+		groupClean(id);
 	}
 
 	void DirFrontend::storeIntro(const QString &name, quint64 id, bool create)
 	{
-		bool exmk = true;
-		QDir dir = categoryDir("intro", &exmk);
+		QString path = "intro";
+		DirHandle dir = dirHandle(path, true);
 		QString filename = encodeFilename(name);
-		QFile file(dir.absoluteFilePath(filename));
-		if(!create && !file.exists())
+		QFile file;
+		if(!create && !dir.exists(filename))
 			return;
-		else if(!file.open(QFile::WriteOnly))
+		else if(!dir.open(&file, filename, QFile::WriteOnly))
 			throw FrontendException("Error opening object file");
+		bindId(idPath(path, filename), id);
 		QTextStream stream(&file);
 		stream.setCodec("UTF-8");
-		KeyEditor ed(&meta);
-		ed.select(&introObject);
-		ed.uintPut(IntroObject::ObjectId, id);
-		size_t l = lower(ed);
-		size_t u = prefixUpper(ed);
+		KeyCodec<IntroObject> objkey;
+		objkey.objectId = id;
+		size_t l;
+		size_t u;
+		prefixRange(&l, &u, objkey, IntroObject::ObjectId);
 		for(; l < u; l++) {
-			ed.load(key(l));
-			QString name = enum2name(ed.enumGet<IntroPropertyId>(IntroObject::PropertyId));
-			const DeclValue *mapto = ed.mapto();
-			if(ed.uintGet(IntroObject::LanguageId)) {
+			if(!objkey.decode(key(l)))
+				throw FrontendException("(internal) invalid object key");
+			QString name = enum2name(EnumInfo<IntroPropertyId>::fromInt(objkey.propertyId));
+			const DeclValue *mapto = value(l)->decl();
+			if(objkey.languageId) {
 				QString language;
-				language = enum2name(ed.enumGet<LanguageId>(IntroObject::LanguageId));
+				language = enum2name(EnumInfo<LanguageId>::fromInt(objkey.languageId));
 				stream << name << " [" << language << "]:\n";
 			}
 			else
@@ -1104,13 +1160,16 @@ namespace spec { namespace v1_0 {
 
 	void DirFrontend::actionLoad()
 	{
-		loadPersons();
-		loadLocations();
-		loadBibliography();
-		loadLetters();
-		loadPhilComments();
-		loadHistComments();
-		loadIntro();
+		//one pass over the whole database directory; the loaders only open files, which are known to exist
+		_dirHandles.clear();
+		DirScanner::Tree tree = DirScanner::scan(dirHandle(QString(), false));
+		loadPersons(tree);
+		loadLocations(tree);
+		loadBibliography(tree);
+		loadLetters(tree);
+		loadPhilComments(tree);
+		loadHistComments(tree);
+		loadIntro(tree);
 	}
 
 	void DirFrontend::actionSave()
@@ -1203,45 +1262,139 @@ namespace spec { namespace v1_0 {
 		}
 	}
 
+	void DirFrontend::actionFault(const QByteArray &prefix)
+	{
+		if(_unloaded.isEmpty())
+			return;
+		KeyEditor ed(&meta, prefix);
+		const DeclKey *decl = ed.decl();
+		size_t field;
+		if(decl == &textContent)
+			field = KeyInfo<TextContent>::toInt(TextContent::LetterId);
+		else if(decl == &textMetadata)
+			field = KeyInfo<TextMetadata>::toInt(TextMetadata::LetterId);
+		else if(decl == &textTranslation)
+			field = KeyInfo<TextTranslation>::toInt(TextTranslation::LetterId);
+		else if(decl == &textComment)
+			field = KeyInfo<TextComment>::toInt(TextComment::LetterId);
+		else if(decl == &textLetter) {
+			if(ed.isKey())
+				loadUnloaded(actionGroup(prefix));
+			return;
+		}
+		else {
+			//prefix may span letter contents of all letters
+			bool spans = !decl;
+			for(const DeclKey *cur = textContent.parent; cur && !spans; cur = cur->parent)
+				spans = cur == decl;
+			if(spans)
+				for(auto it : _unloaded.values())
+					loadUnloaded(it);
+			return;
+		}
+		if(ed.fields() > field)
+			loadUnloaded(ed.uintGetAt(field));
+		else
+			for(auto it : _unloaded.values())
+				loadUnloaded(it);
+	}
+
+	quint64 DirFrontend::actionGroup(const QByteArray &key)
+	{
+		KeyEditor ed(&meta, key);
+		const DeclKey *decl = ed.decl();
+		size_t field;
+		if(decl == &textContent)
+			field = KeyInfo<TextContent>::toInt(TextContent::LetterId);
+		else if(decl == &textMetadata)
+			field = KeyInfo<TextMetadata>::toInt(TextMetadata::LetterId);
+		else if(decl == &textTranslation)
+			field = KeyInfo<TextTranslation>::toInt(TextTranslation::LetterId);
+		else if(decl == &textComment)
+			field = KeyInfo<TextComment>::toInt(TextComment::LetterId);
+		else if(decl == &textLetter && ed.isKey()) {
+			Value *value = peek(key);
+			return value ? value->to<ObjectRef>()->id : 0;
+		}
+		else
+			return 0;
+		return ed.fields() > field ? ed.uintGetAt(field) : 0;
+	}
+
+	void DirFrontend::actionEvict(quint64 group)
+	{
+		if(!_letterDirs.contains(group) || _unloaded.contains(group))
+			return;
+		KeyEditor ed(&meta);
+		ed.select(&textContent);
+		ed.uintPut(TextContent::LetterId, group);
+		unload(ed);
+		ed.select(&textMetadata);
+		ed.uintPut(TextMetadata::LetterId, group);
+		unload(ed);
+		ed.select(&textTranslation);
+		ed.uintPut(TextTranslation::LetterId, group);
+		unload(ed);
+		ed.select(&textComment);
+		ed.uintPut(TextComment::LetterId, group);
+		unload(ed);
+		_unloaded.insert(group);
+	}
+
 	void DirFrontend::actionErase(const QByteArray &key, Value *value)
 	{
 		KeyEditor keyed(&meta, key);
-		bool exmk = false;
 
 		if(keyed.decl() == &personClass) {
-			QDir dir = categoryDir("person", &exmk);
+			QString path = "person";
+			DirHandle dir = dirHandle(path, false);
 			QString name = keyed.stringGet(PersonClass::ObjectName);
-			if(exmk)
-				QFile(dir.absoluteFilePath(encodeFilename(name))).remove();
+			if(dir.isValid()) {
+				dir.remove(encodeFilename(name));
+				unbindId(idPath(path, encodeFilename(name)));
+			}
 		}
 		else if(keyed.decl() == &locationClass) {
 			auto type = keyed.enumGet<LocationType>(LocationClass::Type);
-			QDir dir = categoryDir(QStringList({ "location", EnumInfo<LocationType>::name(type) }), &exmk);
+			QString path = QString("location/") + EnumInfo<LocationType>::name(type);
+			DirHandle dir = dirHandle(path, false);
 			QString name = keyed.stringGet(LocationClass::ObjectName);
-			if(exmk)
-				QFile(dir.absoluteFilePath(encodeFilename(name))).remove();
+			if(dir.isValid()) {
+				dir.remove(encodeFilename(name));
+				unbindId(idPath(path, encodeFilename(name)));
+			}
 		}
 		else if(keyed.decl() == &bibliographyClass) {
 			auto type = keyed.enumGet<BibliographyType>(BibliographyClass::Type);
-			QDir dir = categoryDir(QStringList({ "bibliography", EnumInfo<BibliographyType>::name(type) }), &exmk);
+			QString path = QString("bibliography/") + EnumInfo<BibliographyType>::name(type);
+			DirHandle dir = dirHandle(path, false);
 			QString name = keyed.stringGet(BibliographyClass::ObjectName);
-			if(exmk)
-				QFile(dir.absoluteFilePath(encodeFilename(name))).remove();
+			if(dir.isValid()) {
+				dir.remove(encodeFilename(name));
+				unbindId(idPath(path, encodeFilename(name)));
+			}
 		}
 		else if(keyed.decl() == &philCommentClass) {
-			QDir dir = categoryDir("phil-comment", &exmk);
+			QString path = "phil-comment";
+			DirHandle dir = dirHandle(path, false);
 			QString name = keyed.stringGet(PhilCommentClass::ObjectName);
-			if(exmk)
-				QFile(dir.absoluteFilePath(encodeFilename(name))).remove();
+			if(dir.isValid()) {
+				dir.remove(encodeFilename(name));
+				unbindId(idPath(path, encodeFilename(name)));
+			}
 		}
 		else if(keyed.decl() == &histCommentClass) {
 			HistCommentType type = keyed.enumGet<HistCommentType>(HistCommentClass::Type);
-			QDir dir = categoryDir(QStringList({ "hist-comment", EnumInfo<HistCommentType>::name(type) }), &exmk);
+			QString path = QString("hist-comment/") + EnumInfo<HistCommentType>::name(type);
+			DirHandle dir = dirHandle(path, false);
 			QString name = keyed.stringGet(HistCommentClass::ObjectName);
-			if(exmk)
-				QFile(dir.absoluteFilePath(encodeFilename(name))).remove();
+			if(dir.isValid()) {
+				dir.remove(encodeFilename(name));
+				unbindId(idPath(path, encodeFilename(name)));
+			}
 		}
 		else if(keyed.decl() == &textBook) {
+			unbindId(bookPath(keyed.uintGet(TextBook::ObjectNumber)));
 		}
 		else if(keyed.decl() == &textLetter) {
 			quint64 bookid = keyed.uintGet(TextLetter::BookId);
@@ -1249,23 +1402,30 @@ namespace spec { namespace v1_0 {
 			quint64 letnum = _id2number.value(letid);
 			quint64 booknum = _id2number.value(bookid);
 			_id2number.remove(letid);
-			QDir dir = letterDir(booknum, letnum, &exmk);
-			if(exmk) {
-				QString dirname = dir.dirName();
-				QFile(dir.absoluteFilePath("content")).remove();
-				QFile(dir.absoluteFilePath("metadata")).remove();
-				QFile(dir.absoluteFilePath("translation")).remove();
+			_unloaded.remove(letid);
+			_letterDirs.remove(letid);
+			groupRemoved(letid);
+			unbindId(letterPath(booknum, letnum), true);
+			QString lpath = letterPath(booknum, letnum);
+			DirHandle dir = dirHandle(lpath, false);
+			if(dir.isValid()) {
+				dir.remove("content");
+				dir.remove("metadata");
+				dir.remove("translation");
 				for(size_t i = 0; i < annotatedType.nEnumValues; i++)
-					QFile(dir.absoluteFilePath(annotatedType.enumValues[i].name)).remove();
-				if(dir.cdUp())
-					dir.rmdir(dirname);
+					dir.remove(annotatedType.enumValues[i].name);
+				dirHandle(bookPath(booknum), false).rmdir(QString("%1").arg(letnum));
+				dropDirHandles(lpath);
 			}
 		}
 		else if(keyed.decl() == &introClass) {
-			QDir dir = categoryDir("intro", &exmk);
+			QString path = "intro";
+			DirHandle dir = dirHandle(path, false);
 			QString name = keyed.stringGet(IntroClass::ObjectName);
-			if(exmk)
-				QFile(dir.absoluteFilePath(encodeFilename(name))).remove();
+			if(dir.isValid()) {
+				dir.remove(encodeFilename(name));
+				unbindId(idPath(path, encodeFilename(name)));
+			}
 		}
 	}
 
@@ -1318,8 +1478,10 @@ namespace spec { namespace v1_0 {
 		else if(ed.decl() == &textBook) {
 			quint64 id = value->to<ObjectRef>()->id;
 			quint64 num = ed.uintGet(TextBook::ObjectNumber);
-			if(id)
+			if(id) {
 				_id2number.insert(id, num);
+				bindId(bookPath(num), id);
+			}
 			else
 				throw 1;
 		}
@@ -0,0 +1,248 @@
+#include <QDir>
+#include <QFileInfo>
+
+#include <algorithm>
+
+#ifdef Q_OS_LINUX
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "dirscan.h"
+
+namespace {
+	bool entryLessThan(const QString &a, const QString &b)
+	{
+		int cmp = a.compare(b, Qt::CaseInsensitive);
+		return cmp ? cmp < 0 : a < b;
+	}
+
+#ifdef Q_OS_LINUX
+	//record layout of getdents64(); glibc does not export it
+	struct LinuxDirent64 {
+		quint64 d_ino;
+		qint64 d_off;
+		unsigned short d_reclen;
+		unsigned char d_type;
+		char d_name[1];
+	};
+
+	const size_t DirentBufferSize = 32 * 1024;
+#endif
+}
+
+struct DirHandle::Data {
+	Data(int fd, const QString &path) : fd(fd), path(path) {}
+	~Data() {
+#ifdef Q_OS_LINUX
+		::close(fd);
+#endif
+	}
+
+	int fd; //-1, if descriptors are not used
+	QString path;
+};
+
+DirHandle::DirHandle()
+{}
+
+DirHandle::DirHandle(const QString &path)
+{
+#ifdef Q_OS_LINUX
+	int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if(fd >= 0)
+		_d.reset(new Data(fd, QDir::cleanPath(path)));
+#else
+	if(QFileInfo(path).isDir())
+		_d.reset(new Data(-1, QDir::cleanPath(path)));
+#endif
+}
+
+bool DirHandle::isValid() const
+{
+	return !_d.isNull();
+}
+
+QString DirHandle::path() const
+{
+	return _d ? _d->path : QString();
+}
+
+QString DirHandle::filePath(const QString &name) const
+{
+	return _d ? _d->path + '/' + name : QString();
+}
+
+DirHandle DirHandle::child(const QString &name) const
+{
+	DirHandle result;
+	if(!_d)
+		return result;
+#ifdef Q_OS_LINUX
+	int fd = ::openat(_d->fd, QFile::encodeName(name).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if(fd >= 0)
+		result._d.reset(new Data(fd, filePath(name)));
+#else
+	if(QFileInfo(filePath(name)).isDir())
+		result._d.reset(new Data(-1, filePath(name)));
+#endif
+	return result;
+}
+
+bool DirHandle::open(QFile *file, const QString &name, QIODevice::OpenMode mode) const
+{
+	if(!_d)
+		return false;
+#ifdef Q_OS_LINUX
+	int flags;
+	if((mode & QIODevice::ReadWrite) == QIODevice::ReadWrite)
+		flags = O_RDWR | O_CREAT;
+	else if(mode & QIODevice::WriteOnly)
+		flags = O_WRONLY | O_CREAT | (mode & QIODevice::Append ? O_APPEND : O_TRUNC);
+	else
+		flags = O_RDONLY;
+	int fd = ::openat(_d->fd, QFile::encodeName(name).constData(), flags | O_CLOEXEC, 0666);
+	if(fd < 0)
+		return false;
+	else if(!file->open(fd, mode, QFileDevice::AutoCloseHandle)) {
+		::close(fd);
+		return false;
+	}
+	return true;
+#else
+	file->setFileName(filePath(name));
+	return file->open(mode);
+#endif
+}
+
+bool DirHandle::exists(const QString &name) const
+{
+	if(!_d)
+		return false;
+#ifdef Q_OS_LINUX
+	struct stat st;
+	return ::fstatat(_d->fd, QFile::encodeName(name).constData(), &st, 0) == 0;
+#else
+	return QFileInfo::exists(filePath(name));
+#endif
+}
+
+bool DirHandle::remove(const QString &name) const
+{
+	if(!_d)
+		return false;
+#ifdef Q_OS_LINUX
+	return ::unlinkat(_d->fd, QFile::encodeName(name).constData(), 0) == 0;
+#else
+	return QFile::remove(filePath(name));
+#endif
+}
+
+bool DirHandle::mkdir(const QString &name) const
+{
+	if(!_d)
+		return false;
+#ifdef Q_OS_LINUX
+	return ::mkdirat(_d->fd, QFile::encodeName(name).constData(), 0777) == 0;
+#else
+	return QDir(_d->path).mkdir(name);
+#endif
+}
+
+bool DirHandle::rmdir(const QString &name) const
+{
+	if(!_d)
+		return false;
+#ifdef Q_OS_LINUX
+	return ::unlinkat(_d->fd, QFile::encodeName(name).constData(), AT_REMOVEDIR) == 0;
+#else
+	return QDir(_d->path).rmdir(name);
+#endif
+}
+
+bool DirScanner::list(const DirHandle &dir, QStringList *files, QStringList *dirs)
+{
+	if(!dir.isValid())
+		return false;
+#ifdef Q_OS_LINUX
+	int fd = dir._d->fd;
+	if(::lseek(fd, 0, SEEK_SET) < 0) //handles may be listed more than once
+		return false;
+	alignas(LinuxDirent64) char buffer[DirentBufferSize];
+	for(;;) {
+		long n = ::syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+		if(n < 0)
+			return false;
+		else if(n == 0)
+			break;
+		for(long pos = 0; pos < n;) {
+			const LinuxDirent64 *ent = reinterpret_cast<const LinuxDirent64*>(buffer + pos);
+			pos += ent->d_reclen;
+			if(ent->d_name[0] == '.') //hidden, '.' and '..'; like QDir without QDir::Hidden
+				continue;
+			unsigned char type = ent->d_type;
+			if(type == DT_UNKNOWN || type == DT_LNK) { //symlinks are followed, like QDir does
+				struct stat st;
+				if(::fstatat(fd, ent->d_name, &st, 0) < 0)
+					continue;
+				else if(S_ISDIR(st.st_mode))
+					type = DT_DIR;
+				else if(S_ISREG(st.st_mode))
+					type = DT_REG;
+			}
+			if(type == DT_DIR && dirs)
+				dirs->append(QFile::decodeName(ent->d_name));
+			else if(type == DT_REG && files)
+				files->append(QFile::decodeName(ent->d_name));
+		}
+	}
+#else
+	QDir qdir(dir.path());
+	if(!qdir.exists())
+		return false;
+	if(files)
+		*files = qdir.entryList(QDir::Files, QDir::Unsorted);
+	if(dirs)
+		*dirs = qdir.entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Unsorted);
+#endif
+	if(files)
+		std::sort(files->begin(), files->end(), entryLessThan);
+	if(dirs)
+		std::sort(dirs->begin(), dirs->end(), entryLessThan);
+	return true;
+}
+
+DirScanner::Tree DirScanner::scan(const DirHandle &root)
+{
+	struct Pending {
+		DirHandle parent;
+		QString name;
+		QString path;
+	};
+
+	Tree result;
+	Dir top;
+	if(!list(root, &top.files, &top.dirs))
+		return result;
+
+	//children are opened when they are visited, not when they are queued: a pending entry only references its parent's descriptor
+	QList<Pending> stack;
+	for(int i = top.dirs.size() - 1; i >= 0; i--)
+		stack.append({ root, top.dirs.at(i), top.dirs.at(i) });
+	result.insert(top.path, top);
+	while(!stack.isEmpty()) {
+		Pending pending = stack.takeLast();
+		DirHandle handle = pending.parent.child(pending.name);
+		Dir dir;
+		dir.path = pending.path;
+		if(!list(handle, &dir.files, &dir.dirs))
+			continue;
+		for(int i = dir.dirs.size() - 1; i >= 0; i--)
+			stack.append({ handle, dir.dirs.at(i), dir.path + '/' + dir.dirs.at(i) });
+		result.insert(dir.path, dir);
+	}
+	return result;
+}
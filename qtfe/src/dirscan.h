@@ -0,0 +1,50 @@
+#pragma once
+
+#include <QFile>
+#include <QHash>
+#include <QSharedPointer>
+#include <QStringList>
+
+//open directory; entries are opened relative to it. on linux, this holds an O_DIRECTORY file descriptor, so no path is resolved
+//more than once. elsewhere, it is just the path.
+//copies share the descriptor; it is closed with the last copy.
+class DirHandle {
+	public:
+		DirHandle(); //invalid handle
+		explicit DirHandle(const QString &path); //invalid, if 'path' is no directory
+
+		bool isValid() const;
+		QString path() const;
+		QString filePath(const QString &name) const;
+
+		DirHandle child(const QString &name) const; //subdirectory; invalid, if it does not exist
+		bool open(QFile *file, const QString &name, QIODevice::OpenMode mode) const; //'file' must not have a file name set
+		bool exists(const QString &name) const;
+		bool remove(const QString &name) const; //remove file
+		bool mkdir(const QString &name) const;
+		bool rmdir(const QString &name) const; //handles of the removed directory stay open, but refer to a deleted directory
+
+	private:
+		friend class DirScanner;
+
+		struct Data;
+		QSharedPointer<Data> _d;
+};
+
+//directory enumeration without QDir: on linux, entries are read with getdents64(), so the type of most entries is known without stat()
+class DirScanner {
+	public:
+		struct Dir {
+			QString path; //relative to the scanned root, '/'-separated; empty for the root itself
+			QStringList files; //regular files, sorted like QDir::entryList()
+			QStringList dirs; //subdirectories, sorted like QDir::entryList()
+		};
+		typedef QHash<QString, Dir> Tree; //[Dir::path] -> Dir
+
+		//list a single directory; hidden entries are skipped. returns false, if 'dir' is invalid or cannot be read
+		static bool list(const DirHandle &dir, QStringList *files, QStringList *dirs);
+
+		//enumerate the whole tree below 'root' in one pass. only the directories on the current path are kept open,
+		//so the number of descriptors in use is bounded by the depth of the tree. unreadable subdirectories are left out.
+		static Tree scan(const DirHandle &root);
+};
@@ -0,0 +1,352 @@
+#include <QCoreApplication>
+#include <QFutureInterface>
+#include <QMutex>
+#include <QQueue>
+#include <QThread>
+#include <QWaitCondition>
+
+#include "key.h"
+#include "frontend.h"
+
+using namespace spec;
+
+namespace {
+	template<typename T> struct JobResult {
+		static void report(QFutureInterface<T> &iface, const std::function<T(SyncFrontend*)> &job, SyncFrontend *backend) {
+			iface.reportResult(job(backend));
+		}
+	};
+
+	template<> struct JobResult<void> {
+		static void report(QFutureInterface<void> &iface, const std::function<void(SyncFrontend*)> &job, SyncFrontend *backend) {
+			job(backend);
+		}
+	};
+
+	template<typename T> QFuture<T> ready(const T &result)
+	{
+		QFutureInterface<T> iface;
+		iface.reportStarted();
+		iface.reportResult(result);
+		iface.reportFinished();
+		return iface.future();
+	}
+
+	//like AsyncFrontend::then(), but also called for canceled futures
+	template<typename T, typename F> void whenDone(const QFuture<T> &future, QObject *context, F fn)
+	{
+		QFutureWatcher<T> *watcher = new QFutureWatcher<T>(context);
+		QObject::connect(watcher, &QFutureWatcherBase::finished, context, [watcher, fn]() mutable {
+			fn();
+			watcher->deleteLater();
+		});
+		watcher->setFuture(future);
+	}
+
+	//copy contents of 'src' into 'dst'; both must be of the same type
+	void assign(const DeclMeta *meta, Value *dst, const Value &src)
+	{
+		if(dst->decl() != src.decl())
+			throw FrontendException("cannot assign value: type mismatch");
+		QByteArray data;
+		BinaryWriter writer(&data);
+		src.serialize(writer);
+		BinaryReader reader(meta, data.constData(), data.size());
+		if(!dst->deserialize(reader))
+			throw FrontendException("cannot assign value: malformed data");
+	}
+}
+
+class AsyncFrontend::Worker : public QThread {
+	public:
+		void enqueue(const std::function<void()> &job) {
+			QMutexLocker locker(&_mutex);
+			_jobs.enqueue(job);
+			_cond.wakeOne();
+		}
+
+		void stop() {
+			enqueue(std::function<void()>()); //empty job: stop marker, processed after all pending jobs
+			wait();
+		}
+
+	protected:
+		virtual void run() override {
+			for(;;) {
+				std::function<void()> job;
+				{
+					QMutexLocker locker(&_mutex);
+					if(_jobs.isEmpty()) {
+						//no event loop runs here: deliver what the jobs posted to this thread, e.g. the deferred journal flush of a DirFrontend, before going idle
+						locker.unlock();
+						QCoreApplication::processEvents();
+						locker.relock();
+					}
+					while(_jobs.isEmpty())
+						_cond.wait(&_mutex);
+					job = _jobs.dequeue();
+				}
+				if(!job)
+					return;
+				job();
+			}
+		}
+
+	private:
+		QMutex _mutex;
+		QWaitCondition _cond;
+		QQueue<std::function<void()>> _jobs;
+};
+
+AsyncFrontend::AsyncFrontend(SyncFrontend *backend) : Frontend(backend->spec()), _backend(backend), _worker(new Worker())
+{
+	_worker->start();
+}
+
+AsyncFrontend::~AsyncFrontend()
+{
+	_worker->stop();
+	delete _worker;
+}
+
+template<typename T> QFuture<T> AsyncFrontend::post(const std::function<T(SyncFrontend *backend)> &job)
+{
+	QFutureInterface<T> iface;
+	iface.reportStarted();
+	SyncFrontend *backend = _backend;
+	_worker->enqueue([iface, job, backend]() mutable {
+		try {
+			JobResult<T>::report(iface, job, backend);
+		}
+		catch(const Exception &e) {
+			qWarning("async frontend job failed: %s", qPrintable(e.message()));
+			iface.reportCanceled();
+		}
+		catch(...) { //e.g. std::bad_alloc or 'throw 1' from AvlTable; escaping the worker would terminate the application
+			qWarning("async frontend job failed");
+			iface.reportCanceled();
+		}
+		iface.reportFinished();
+	});
+	return iface.future();
+}
+
+QFuture<AsyncFrontend::ValuePtr> AsyncFrontend::get(const QByteArray &key)
+{
+	return post<ValuePtr>([key](SyncFrontend *backend) {
+		return clone(backend->get(key));
+	});
+}
+
+QFuture<QList<AsyncFrontend::Entry>> AsyncFrontend::prefixScan(const QByteArray &prefix)
+{
+	return post<QList<Entry>>([prefix](SyncFrontend *backend) {
+		QList<Entry> result;
+		size_t u = backend->prefixUpper(prefix);
+		for(size_t i = backend->lower(prefix); i < u; i++)
+			result.append(Entry(backend->key(i), clone(backend->value(i))));
+		return result;
+	});
+}
+
+QFuture<void> AsyncFrontend::put(const QByteArray &key, const Value &value)
+{
+	//copy now, the caller may change 'value' before the job runs
+	ValuePtr copy = clone(&value);
+	const DeclMeta *meta = spec();
+	return post<void>([key, copy, meta](SyncFrontend *backend) {
+		assign(meta, backend->get(key, true), *copy);
+		backend->modified(key);
+	});
+}
+
+QFuture<void> AsyncFrontend::erase(const QByteArray &key)
+{
+	return post<void>([key](SyncFrontend *backend) {
+		backend->erase(key);
+	});
+}
+
+QFuture<void> AsyncFrontend::prefixErase(const QByteArray &prefix)
+{
+	return post<void>([prefix](SyncFrontend *backend) {
+		backend->prefixErase(prefix);
+	});
+}
+
+QFuture<void> AsyncFrontend::run(const std::function<void(SyncFrontend *backend)> &job)
+{
+	return post<void>(job);
+}
+
+AsyncFrontend::ValuePtr AsyncFrontend::clone(const Value *value)
+{
+	if(!value)
+		return ValuePtr();
+	const DeclValue *decl = value->decl();
+	return ValuePtr(value->clone(), [decl](Value *v) { decl->destroy(v); });
+}
+
+CacheFrontend::CacheFrontend(const DeclMeta *spec, size_t capacity) : MemoryFrontend(spec), _capacity(capacity), _tick(0)
+{
+}
+
+bool CacheFrontend::covers(const QByteArray &prefix)
+{
+	auto it = _complete.find(prefix);
+	if(it == _complete.end())
+		return false;
+	*it = ++_tick;
+	return true;
+}
+
+void CacheFrontend::fill(const QByteArray &prefix, const QList<AsyncFrontend::Entry> &entries)
+{
+	MemoryFrontend::prefixErase(prefix);
+	for(const auto &it : entries)
+		store(it.first, it.second.data());
+	_complete.insert(prefix, ++_tick);
+
+	while(_capacity && size_t(_complete.size()) > _capacity) {
+		auto lru = _complete.begin();
+		for(auto it = _complete.begin(); it != _complete.end(); ++it)
+			if(it.value() < lru.value())
+				lru = it;
+		drop(lru.key());
+	}
+}
+
+void CacheFrontend::store(const QByteArray &key, const Value *value)
+{
+	if(!value)
+		erase(key);
+	else {
+		assign(spec(), get(key, true), *value);
+		modified(key);
+	}
+}
+
+void CacheFrontend::drop(const QByteArray &prefix)
+{
+	for(auto it = _complete.begin(); it != _complete.end();)
+		if(it.key().startsWith(prefix))
+			it = _complete.erase(it);
+		else
+			++it;
+	MemoryFrontend::prefixErase(prefix);
+}
+
+void CacheFrontend::reset()
+{
+	drop(QByteArray());
+}
+
+CachingFrontend::CachingFrontend(SyncFrontend *backend, CacheFrontend *cache) : AsyncFrontend(backend), _cache(cache)
+{
+	if(cache->spec() != backend->spec())
+		throw FrontendException("cache and backend specs differ");
+}
+
+Value *CachingFrontend::cached(const QByteArray &key, bool *known)
+{
+	//writes go through the cache, so a cached key is always up to date
+	Value *value = _cache->get(key);
+	if(known)
+		*known = value || _cache->covers(groupPrefix(key));
+	return value;
+}
+
+QByteArray CachingFrontend::groupPrefix(const QByteArray &key) const
+{
+	if(key.isEmpty())
+		return key;
+	KeyEditor keyed(spec(), key);
+	size_t n = 0;
+	while(n < keyed.fields() && keyed.isKeyFieldAt(n))
+		n++;
+	if(n < keyed.fields())
+		n++;
+	return keyed.cutAt(0, n);
+}
+
+QFuture<QList<AsyncFrontend::Entry>> CachingFrontend::fetch(const QByteArray &group)
+{
+	auto pending = _pending.find(group);
+	if(pending != _pending.end())
+		return *pending;
+	QFuture<QList<Entry>> scan = AsyncFrontend::prefixScan(group);
+	_pending.insert(group, scan);
+	whenDone(scan, &_context, [this, group, scan]() {
+		//a write to the group after the fetch has been issued removes it from '_pending'; the result is outdated then
+		auto it = _pending.find(group);
+		if(it == _pending.end() || *it != scan)
+			return;
+		_pending.erase(it);
+		if(!scan.isCanceled())
+			_cache->fill(group, scan.result());
+	});
+	return scan;
+}
+
+QFuture<AsyncFrontend::ValuePtr> CachingFrontend::get(const QByteArray &key)
+{
+	bool known;
+	Value *value = cached(key, &known);
+	if(known)
+		return ready(clone(value));
+
+	QFutureInterface<ValuePtr> iface;
+	iface.reportStarted();
+	QFuture<QList<Entry>> scan = fetch(groupPrefix(key));
+	whenDone(scan, &_context, [iface, scan, key]() mutable {
+		if(scan.isCanceled())
+			iface.reportCanceled();
+		else {
+			ValuePtr result;
+			for(const auto &it : scan.result())
+				if(it.first == key) {
+					result = clone(it.second.data());
+					break;
+				}
+			iface.reportResult(result);
+		}
+		iface.reportFinished();
+	});
+	return iface.future();
+}
+
+QFuture<QList<AsyncFrontend::Entry>> CachingFrontend::prefixScan(const QByteArray &prefix)
+{
+	if(!_cache->covers(prefix))
+		return AsyncFrontend::prefixScan(prefix);
+	QList<Entry> result;
+	size_t u = _cache->prefixUpper(prefix);
+	for(size_t i = _cache->lower(prefix); i < u; i++)
+		result.append(Entry(_cache->key(i), clone(_cache->value(i))));
+	return ready(result);
+}
+
+QFuture<void> CachingFrontend::put(const QByteArray &key, const Value &value)
+{
+	_pending.remove(groupPrefix(key));
+	_cache->store(key, &value);
+	return AsyncFrontend::put(key, value);
+}
+
+QFuture<void> CachingFrontend::erase(const QByteArray &key)
+{
+	_pending.remove(groupPrefix(key));
+	_cache->erase(key);
+	return AsyncFrontend::erase(key);
+}
+
+QFuture<void> CachingFrontend::prefixErase(const QByteArray &prefix)
+{
+	for(auto it = _pending.begin(); it != _pending.end();)
+		if(it.key().startsWith(prefix) || prefix.startsWith(it.key()))
+			it = _pending.erase(it);
+		else
+			++it;
+	_cache->prefixErase(prefix);
+	return AsyncFrontend::prefixErase(prefix);
+}
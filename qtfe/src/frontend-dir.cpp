@@ -1,3 +1,16 @@
+#include <QSaveFile>
+#include <QTextStream>
+#include <QThread>
+#include <QTimer>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <exception>
+
 #include <common/base32.h>
 
 #include "key.h"
@@ -5,39 +18,112 @@
  
 using namespace spec;
 
+static const char *IdMapFile = ".ids";
+static const char *JournalFile = ".journal";
+
+//journal batch: u32 body length, u64 checksum of body, body: u16 n id counters, n * u64 counter, u32 n entries, entries.
+//entry: u8 op, key (u32 length + bytes), serialized value (u32 length + bytes)
+enum JournalOp {
+	JournalErase = 1, //value before erasing; the object file has to be removed
+	JournalModify = 2, //new value; the object file has to be written
+	JournalPut = 3 //new value of a row stored in the file of a modified owner
+};
+
+static const int JournalHeaderSize = 4 + 8;
+
+namespace {
+	QByteArray serialized(const spec::Value *value)
+	{
+		QByteArray data;
+		spec::BinaryWriter writer(&data);
+		value->serialize(writer);
+		return data;
+	}
+}
+
+bool AbstractDirFrontend::syncFile(QFile &file)
+{
+	if(!file.flush())
+		return false;
+#ifdef Q_OS_WIN
+	return _commit(file.handle()) == 0;
+#else
+	return fsync(file.handle()) == 0;
+#endif
+}
+
 QString AbstractDirFrontend::decodeFilename(const QString &filename)
 {
-	QByteArray data = filename.toUpper().toLocal8Bit();
+	QByteArray data = filename.toLatin1();
 	QByteArray utf8;
 	ssize_t len = base32_decsize(data.size());
 	if(len < 0)
 		return QString();
 	utf8.resize(len);
-	base32_dec(utf8.data(), data.constData());
+	if(base32_decn(utf8.data(), data.constData(), data.size()) < 0)
+		return QString();
 	return QString::fromUtf8(utf8);
 }
 
+QStringList AbstractDirFrontend::decodeFilenames(const QStringList &filenames)
+{
+	QStringList result;
+	QByteArray data;
+	QByteArray arena;
+	QVector<size_t> srcoff(filenames.size() + 1);
+	QVector<size_t> destoff(filenames.size() + 1);
+
+	srcoff[0] = 0;
+	for(int i = 0; i < filenames.size(); i++) {
+		data.append(filenames.at(i).toLatin1());
+		srcoff[i + 1] = data.size();
+	}
+	arena.resize(data.size() * 5 / 8);
+	base32_dec_batch(arena.data(), destoff.data(), data.constData(), srcoff.constData(), filenames.size());
+
+	result.reserve(filenames.size());
+	for(int i = 0; i < filenames.size(); i++) {
+		if(destoff[i] == destoff[i + 1] && srcoff[i] != srcoff[i + 1])
+			result.append(QString());
+		else
+			result.append(QString::fromUtf8(arena.constData() + destoff[i], destoff[i + 1] - destoff[i]));
+	}
+	return result;
+}
+
 QString AbstractDirFrontend::encodeFilename(const QString &name)
 {
 	QByteArray data;
 	QByteArray utf8 = name.toUtf8();
 	data.resize(base32_encsize(utf8.size()));
-	base32_enc(data.data(), utf8.constData(), utf8.size());
-	return QString::fromLocal8Bit(data).toLower();
+	base32_enc_lower(data.data(), utf8.constData(), utf8.size());
+	return QString::fromLatin1(data);
 }
 
 AbstractDirFrontend::AbstractDirFrontend(const spec::DeclMeta *spec, const QDir &dir)
 	:	SyncFrontend(spec),
 		_suspended(false),
-		_rootdir(dir)
+		_lazy(false),
+		_faulting(false),
+		_budget(0),
+		_resident(0),
+		_scans(0),
+		_tick(0),
+		_idsDirty(false),
+		_journaled(false),
+		_flushScheduled(false),
+		_rootdir(dir),
+		_bulkLoading(false)
 {
 	if(!dir.exists())
 		throw FrontendException("No such frontend directory");
 	_nextid.resize(spec->nIdTypes);
+	_store.setFinger(true); //loaders and the per object store loops access keys in ascending order
 }
 
 AbstractDirFrontend::~AbstractDirFrontend()
 {
+	dropFlusher();
 	for(auto it = _store.all(); !it.atEnd(); it.next())
 		it.cell<1>()->decl()->destroy(it.cell<1>());
 }
@@ -46,14 +132,43 @@ void AbstractDirFrontend::load()
 {
 	bool suspended = _suspended;
 	_suspended = true;
-	actionLoad();
+	loadIds();
+	beginBulkLoad();
+	try {
+		actionLoad();
+	}
+	catch(...) {
+		endBulkLoad(); //hand the collected values to the store, which owns them from then on
+		_suspended = suspended;
+		throw;
+	}
+	endBulkLoad();
+	pruneIds();
 	_suspended = suspended;
+	replayJournal();
+	saveIds();
 }
 
 void AbstractDirFrontend::clear()
 {
 }
 
+void AbstractDirFrontend::beginBulkLoad()
+{
+	_bulkLoading = true;
+}
+
+void AbstractDirFrontend::endBulkLoad()
+{
+	if(!_bulkLoading)
+		return;
+	_bulkLoading = false;
+	_store.bulkLoad(std::move(_bulk), [](const AvlTable<1, QByteArray, Value*>::RowTuple &row) {
+		std::get<1>(row)->decl()->destroy(std::get<1>(row));
+	});
+	_bulk.clear();
+}
+
 QDir AbstractDirFrontend::rootdir() const
 {
 	return _rootdir;
@@ -68,24 +183,543 @@ void AbstractDirFrontend::resume()
 {
 	if(_suspended) {
 		_suspended = false;
+		flush();
 		actionSave();
+		saveIds();
+	}
+}
+
+void AbstractDirFrontend::setJournaled(bool journaled)
+{
+	_journaled = journaled;
+}
+
+bool AbstractDirFrontend::isJournaled() const
+{
+	return _journaled;
+}
+
+void AbstractDirFrontend::flush()
+{
+	_flushScheduled = false;
+	if(!_pendingKeys.isEmpty()) {
+		QList<QByteArray> keys;
+		QHash<QByteArray, TxEntry> before;
+		keys.swap(_pendingKeys);
+		before.swap(_pendingBefore);
+		try {
+			materialize(keys, before);
+		}
+		catch(...) {
+			//keep the entries pending, so the next flush retries them; the journal is kept and replayed by the next load() as well
+			QList<QByteArray> newerKeys;
+			QHash<QByteArray, TxEntry> newerBefore;
+			newerKeys.swap(_pendingKeys);
+			newerBefore.swap(_pendingBefore);
+			_pendingKeys = keys;
+			_pendingBefore = before;
+			for(const auto &key : newerKeys)
+				addPending(key, newerBefore[key]);
+			throw;
+		}
+	}
+	if(_pendingKeys.isEmpty() && _journal.isOpen() && _journal.size() && !_journal.resize(0))
+		throw FrontendException("Error truncating journal");
+}
+
+void AbstractDirFrontend::scheduleFlush()
+{
+	if(_flusher && _flusher->thread() != QThread::currentThread())
+		dropFlusher(); //flushes run on the thread that committed, e.g. the worker of an AsyncFrontend
+	if(_flushScheduled)
+		return;
+	if(!_flusher) {
+		_flusher.reset(new QObject());
+		_flushCancelled.reset(new QAtomicInt(0));
+	}
+	_flushScheduled = true;
+	QSharedPointer<QAtomicInt> cancelled = _flushCancelled;
+	QTimer::singleShot(0, _flusher.data(), [this, cancelled]() {
+		if(cancelled->loadAcquire() || !_flushScheduled)
+			return;
+		_flushScheduled = false;
+		if(_suspended || inTransaction()) //resume() flushes; commit() schedules again
+			return;
+		try {
+			flush();
+		}
+		catch(const Exception &e) {
+			qWarning("flushing journal failed: %s", qPrintable(e.message()));
+		}
+	});
+}
+
+void AbstractDirFrontend::dropFlusher()
+{
+	_flushScheduled = false;
+	if(!_flusher)
+		return;
+	_flushCancelled->storeRelease(1);
+	if(_flusher->thread() == QThread::currentThread())
+		_flusher.reset(); //also stops its timer
+	else
+		_flusher.take()->deleteLater(); //only its own thread may delete it; a timer firing before that sees the cancellation
+}
+
+bool AbstractDirFrontend::implicitTransaction(const std::function<void()> &fn)
+{
+	if(!_journaled || _suspended || _faulting || inTransaction())
+		return false;
+	begin();
+	try {
+		fn();
+	}
+	catch(...) {
+		rollback();
+		throw;
+	}
+	commit();
+	return true;
+}
+
+void AbstractDirFrontend::addPending(const QByteArray &key, const TxEntry &entry)
+{
+	auto it = _pendingBefore.find(key);
+	if(it == _pendingBefore.end()) {
+		_pendingBefore.insert(key, entry);
+		_pendingKeys.append(key);
+		return;
+	}
+	//keep the oldest state; it is what the object files still contain
+	it->modified |= entry.modified;
+	if(it->data.isEmpty() && entry.existed) {
+		it->existed = true;
+		it->data = entry.data;
+	}
+}
+
+void AbstractDirFrontend::journalBatch(const QList<QByteArray> &keys, const QHash<QByteArray, TxEntry> &before)
+{
+	QByteArray entries;
+	BinaryWriter writer(&entries);
+	quint32 n = 0;
+	QSet<QByteArray> written;
+	QList<QByteArray> owners;
+	auto entry = [&](JournalOp op, const QByteArray &key, const QByteArray &data) {
+		writer.put(quint8(op));
+		writer.put(key);
+		writer.put(data);
+		written.insert(key);
+		n++;
+	};
+	for(const auto &key : keys) {
+		const TxEntry &e = before[key];
+		Value *value = _store.cell<1>(key);
+		if(!value) {
+			if(e.existed)
+				entry(JournalErase, key, e.data);
+		}
+		else if(e.modified || changedSince(key, e, value)) {
+			entry(JournalModify, key, serialized(value));
+			owners.append(key);
+		}
+	}
+	if(!n)
+		return;
+	//a replay rewrites the owners' files, so their resident rows have to be restored as well
+	for(const auto &key : owners)
+		for(const auto &prefix : ownedPrefixes(key, _store.cell<1>(key))) {
+			size_t u = storeUpper(prefix);
+			for(size_t l = _store.lower(prefix).index(); l < u; l++)
+				if(!written.contains(_store.cellAt<0>(l)))
+					entry(JournalPut, _store.cellAt<0>(l), serialized(_store.cellAt<1>(l)));
+		}
+
+	QByteArray body;
+	BinaryWriter bodyWriter(&body);
+	bodyWriter.put(quint16(_nextid.size()));
+	for(auto it : _nextid)
+		bodyWriter.put(quint64(it));
+	bodyWriter.put(n);
+	body.append(entries);
+	ValueHasher hasher;
+	hasher.put(body);
+	QByteArray batch;
+	BinaryWriter batchWriter(&batch);
+	batchWriter.put(quint32(body.size()));
+	batchWriter.put(hasher.result());
+	batch.append(body);
+
+	if(!_journal.isOpen()) {
+		_journal.setFileName(_rootdir.absoluteFilePath(JournalFile));
+		if(!_journal.open(QFile::ReadWrite))
+			throw FrontendException("Error opening journal");
+	}
+	if(!_journal.seek(_journal.size()) || _journal.write(batch) != batch.size() || !syncFile(_journal))
+		throw FrontendException("Error writing journal");
+
+	for(const auto &key : keys)
+		addPending(key, before[key]);
+}
+
+void AbstractDirFrontend::replayJournal()
+{
+	_journal.setFileName(_rootdir.absoluteFilePath(JournalFile));
+	if(!_journal.exists() && !_journaled)
+		return;
+	if(!_journal.open(QFile::ReadWrite))
+		throw FrontendException("Error opening journal");
+	QByteArray data = _journal.readAll();
+	int pos = 0;
+	size_t batches = 0;
+	while(data.size() - pos >= JournalHeaderSize) {
+		BinaryReader header(spec(), data.constData() + pos, JournalHeaderSize);
+		quint32 length;
+		quint64 checksum;
+		header.get(length);
+		header.get(checksum);
+		if(length > quint32(data.size() - pos - JournalHeaderSize))
+			break;
+		QByteArray body = data.mid(pos + JournalHeaderSize, length);
+		ValueHasher hasher;
+		hasher.put(body);
+		if(hasher.result() != checksum || !replayBatch(body))
+			break;
+		pos += JournalHeaderSize + length;
+		batches++;
+	}
+	if(pos < data.size())
+		qWarning("journal: dropping %d bytes of incomplete batches", data.size() - pos);
+	if(batches)
+		flush();
+	else if(data.size() && !_journal.resize(0))
+		throw FrontendException("Error truncating journal");
+}
+
+bool AbstractDirFrontend::replayBatch(const QByteArray &body)
+{
+	struct Entry {
+		quint8 op;
+		QByteArray key;
+		QByteArray data;
+	};
+	BinaryReader reader(spec(), body.constData(), body.size());
+	QVector<quint64> ids;
+	QList<Entry> entries;
+	quint16 nIds;
+	quint32 n;
+	if(!reader.get(nIds))
+		return false;
+	for(quint16 i = 0; i < nIds; i++) {
+		quint64 id;
+		if(!reader.get(id))
+			return false;
+		ids.append(id);
+	}
+	if(!reader.get(n))
+		return false;
+	for(quint32 i = 0; i < n; i++) {
+		Entry entry;
+		if(!reader.get(entry.op) || !reader.get(entry.key) || !reader.get(entry.data) || entry.op < JournalErase || entry.op > JournalPut)
+			return false;
+		entries.append(entry);
+	}
+
+	for(int i = 0; i < ids.size() && i < _nextid.size(); i++)
+		_nextid[i] = qMax(_nextid[i], ids[i]);
+	_idsDirty = true;
+	for(const auto &entry : entries) {
+		fault(entry.key);
+		TxEntry pending;
+		pending.existed = true;
+		pending.modified = entry.op == JournalModify;
+		if(entry.op == JournalErase) {
+			auto it = _store.single(entry.key);
+			if(!it.atEnd()) {
+				it.cell<1>()->decl()->destroy(it.cell<1>());
+				_store.removeAt(it.index());
+				_stale.remove(entry.key);
+				publish(entry.key, nullptr);
+			}
+			pending.data = entry.data;
+			addPending(entry.key, pending);
+			continue;
+		}
+		Value *value = _store.cell<1>(entry.key);
+		if(!value) {
+			const DeclValue *mapto = KeyEditor(spec(), entry.key).mapto();
+			if(!mapto)
+				throw FrontendException("journal: key does not map to a value");
+			value = static_cast<Value*>(mapto->create());
+			_store.insert(entry.key, value);
+		}
+		BinaryReader valueReader(spec(), entry.data.constData(), entry.data.size());
+		if(!value->deserialize(valueReader))
+			throw FrontendException("journal: malformed value");
+		_stale.insert(entry.key);
+		publish(entry.key, value);
+		groupDirty(actionGroup(entry.key));
+		if(entry.op == JournalModify)
+			addPending(entry.key, pending);
+	}
+	return true;
+}
+
+bool AbstractDirFrontend::deferred() const
+{
+	return _suspended || inTransaction();
+}
+
+void AbstractDirFrontend::txFlush(const QList<QByteArray> &keys, const QHash<QByteArray, TxEntry> &before)
+{
+	if(_suspended) //resume() saves everything
+		return;
+	else if(_journaled) {
+		journalBatch(keys, before);
+		if(!_pendingKeys.isEmpty()) //also retries entries left by a skipped or failed flush
+			scheduleFlush();
+	}
+	else
+		materialize(keys, before);
+}
+
+void AbstractDirFrontend::materialize(const QList<QByteArray> &keys, const QHash<QByteArray, TxEntry> &before)
+{
+	//erase first: a moved value must not have its new file removed afterwards
+	for(const auto &key : keys) {
+		const TxEntry &entry = before[key];
+		if(!entry.existed || _store.contains(key))
+			continue;
+		Value *old = decode(key, entry);
+		try {
+			actionErase(key, old);
+		}
+		catch(...) {
+			old->decl()->destroy(old);
+			throw;
+		}
+		old->decl()->destroy(old);
+	}
+	//keys passed to modified() are flushed regardless of their own value: editors change rows in place and mark the owning object
+	for(const auto &key : keys) {
+		const TxEntry &entry = before[key];
+		Value *value = _store.cell<1>(key);
+		if(value && (entry.modified || changedSince(key, entry, value)))
+			actionModify(key, value);
+	}
+	saveIds();
+}
+
+void AbstractDirFrontend::setLazy(bool lazy)
+{
+	_lazy = lazy;
+}
+
+bool AbstractDirFrontend::isLazy() const
+{
+	return _lazy;
+}
+
+void AbstractDirFrontend::setMemoryBudget(size_t bytes)
+{
+	_budget = bytes;
+}
+
+size_t AbstractDirFrontend::memoryBudget() const
+{
+	return _budget;
+}
+
+void AbstractDirFrontend::actionFault(const QByteArray &prefix)
+{
+}
+
+quint64 AbstractDirFrontend::actionGroup(const QByteArray &key)
+{
+	return 0;
+}
+
+void AbstractDirFrontend::actionEvict(quint64 group)
+{
+}
+
+void AbstractDirFrontend::fault(const QByteArray &prefix)
+{
+	if(!_lazy || _faulting)
+		return;
+	bool suspended = _suspended;
+	_faulting = true;
+	_suspended = true;
+	try {
+		actionFault(prefix);
+		quint64 group = actionGroup(prefix);
+		touch(group);
+		if(!suspended && group) //a prefix spanning groups is about to be iterated by the caller
+			evict(group);
+	}
+	catch(...) {
+		_faulting = false;
+		_suspended = suspended;
+		throw;
+	}
+	_faulting = false;
+	_suspended = suspended;
+}
+
+void AbstractDirFrontend::touch(quint64 group)
+{
+	auto it = _groups.find(group);
+	if(it == _groups.end())
+		return;
+	_lru.remove(it->tick);
+	it->tick = ++_tick;
+	_lru.insert(it->tick, group);
+}
+
+void AbstractDirFrontend::evict(quint64 keep)
+{
+	if(!_budget || _scans)
+		return;
+	auto it = _lru.begin();
+	while(_resident > _budget && it != _lru.end()) {
+		quint64 group = it.value();
+		const Group &cur = _groups[group];
+		if(group == keep || cur.dirty || _pins.contains(group)) {
+			++it;
+			continue;
+		}
+		_resident -= cur.bytes;
+		_groups.remove(group);
+		it = _lru.erase(it);
+		actionEvict(group);
 	}
 }
 
+void AbstractDirFrontend::groupLoaded(quint64 group, size_t bytes)
+{
+	groupRemoved(group);
+	Group cur;
+	cur.bytes = bytes;
+	_groups.insert(group, cur);
+	_resident += bytes;
+	touch(group);
+}
+
+void AbstractDirFrontend::groupDirty(quint64 group)
+{
+	auto it = _groups.find(group);
+	if(it != _groups.end())
+		it->dirty = true;
+}
+
+void AbstractDirFrontend::groupClean(quint64 group)
+{
+	auto it = _groups.find(group);
+	if(it != _groups.end())
+		it->dirty = false;
+}
+
+void AbstractDirFrontend::groupRemoved(quint64 group)
+{
+	auto it = _groups.find(group);
+	if(it == _groups.end())
+		return;
+	_resident -= it->bytes;
+	_lru.remove(it->tick);
+	_groups.erase(it);
+}
+
+void AbstractDirFrontend::pin(const QByteArray &key)
+{
+	quint64 group = actionGroup(key);
+	if(group)
+		_pins[group]++;
+}
+
+void AbstractDirFrontend::unpin(const QByteArray &key)
+{
+	quint64 group = actionGroup(key);
+	auto it = _pins.find(group);
+	if(it == _pins.end())
+		return;
+	else if(!--it.value())
+		_pins.erase(it);
+}
+
+void AbstractDirFrontend::beginScan()
+{
+	if(_scans++)
+		return;
+	try {
+		fault(QByteArray());
+	}
+	catch(...) {
+		_scans--;
+		throw;
+	}
+}
+
+void AbstractDirFrontend::endScan()
+{
+	if(_scans > 0 && !--_scans && !_suspended && !_faulting)
+		evict();
+}
+
 void AbstractDirFrontend::modified(const QByteArray &key)
 {
-	if(_suspended)
+	if(implicitTransaction([&]() { modified(key); }))
 		return;
+	groupDirty(actionGroup(key));
+	Value *v = _store.cell<1>(key);
+	//editors change rows in place and only mark the owning key, so resident rows below it and rows referencing its ids are rehashed
+	//and published as well; this includes the key itself
+	QList<QByteArray> prefixes = ownedPrefixes(key, v);
+	prefixes.prepend(key);
+	for(const auto &prefix : prefixes) {
+		size_t u = storeUpper(prefix);
+		for(size_t l = _store.lower(prefix).index(); l < u; l++) {
+			_stale.insert(_store.cellAt<0>(l));
+			publish(_store.cellAt<0>(l), _store.cellAt<1>(l));
+		}
+	}
+	_stale.insert(key);
+	if(v)
+		journalModified(key, v);
+	if(deferred())
+		return;
+	fault(key);
 	Value *value = _store.cell<1>(key);
 	if(!value)
 		return;
 	actionModify(key, value);
+	saveIds();
 }
 
+void AbstractDirFrontend::insert(const QByteArray &key, Value *value)
+{
+	if(implicitTransaction([&]() { insert(key, value); }))
+		return;
+	fault(key);
+	Value *cur = _store.cell<1>(key);
+	journalModified(key, cur);
+	if(cur)
+		cur->decl()->destroy(cur);
+	_store.put(key, value);
+	_stale.insert(key);
+	publish(key, value);
+	groupDirty(actionGroup(key));
+	if(deferred())
+		return;
+	actionModify(key, value);
+	saveIds();
+}
 
 Value *AbstractDirFrontend::get(const QByteArray &key, bool create)
 {
+	fault(key);
 	Value *v = _store.cell<1>(key);
+	if((v || create) && !_faulting && !_bulkLoading) //rows read back from disk are no change; a rollback must not erase them
+		journal(key, v);
 	if(!v && create) {
 		KeyEditor keyed(spec(), key);
 		if(!keyed.isValid(true))
@@ -94,49 +728,96 @@ Value *AbstractDirFrontend::get(const QByteArray &key, bool create)
 		if(!mapto)
 			throw FrontendException("error creating value: key does not map to a value");
 		v = static_cast<Value*>(mapto->create());
-		_store.insert(key, v);
+		if(_bulkLoading)
+			_bulk.emplace_back(key, v);
+		else
+			_store.insert(key, v);
+		_stale.insert(key);
+		publish(key, v);
+		if(!_faulting)
+			groupDirty(actionGroup(key));
 	}
 	return v;
 }
 
 void AbstractDirFrontend::erase(const QByteArray &key)
 {
+	if(implicitTransaction([&]() { erase(key); }))
+		return;
+	fault(key);
+	_stale.remove(key);
 	auto it = _store.single(key);
 	if(!it.atEnd()) {
-		if(!_suspended)
+		journal(key, it.cell<1>());
+		groupDirty(actionGroup(key)); //before removal: a letter key is grouped by its value; keeps the group resident until it is written
+		if(!deferred())
 			actionErase(key, it.cell<1>());
 		it.cell<1>()->decl()->destroy(it.cell<1>());
 		_store.removeAt(it.index());
+		publish(key, nullptr);
+		if(!deferred())
+			saveIds();
 	}
 }
 
 void AbstractDirFrontend::move(const QByteArray &oldkey, const QByteArray &newkey)
 {
+	if(implicitTransaction([&]() { move(oldkey, newkey); }))
+		return;
+	fault(oldkey);
 	Value *value = _store.cell<1>(oldkey);
 	if(!value)
 		throw FrontendException("cannot move value: no such value");
 	else if(_store.cell<1>(newkey))
 		throw FrontendException("cannot move value: key already exists");
+	journal(oldkey, value);
+	journal(newkey, nullptr);
+	groupDirty(actionGroup(oldkey));
 	_store.remove(oldkey);
 	_store.put(newkey, value);
-	if(!_suspended) {
+	groupDirty(actionGroup(newkey));
+	_stale.remove(oldkey);
+	_stale.insert(newkey);
+	publish(oldkey, nullptr);
+	publish(newkey, value);
+	if(!deferred()) {
 		actionErase(oldkey, value);
 		actionModify(newkey, value);
+		saveIds();
 	}
 }
 
 void AbstractDirFrontend::prefixErase(const QByteArray &prefix)
 {
+	if(implicitTransaction([&]() { prefixErase(prefix); }))
+		return;
 	size_t l = lower(prefix);
 	size_t u = prefixUpper(prefix);
-	while(u > l) {
-		Value *value = _store.cellAt<1>(l);
-		if(!_suspended)
-			actionErase(_store.cellAt<0>(l), value);
-		value->decl()->destroy(value);
-		_store.removeAt(l);
-		u--;
+	//journaled while still in the store: a rollback restores every row, even if an action below fails
+	for(size_t i = l; i < u; i++) {
+		groupDirty(actionGroup(_store.cellAt<0>(i)));
+		journal(_store.cellAt<0>(i), _store.cellAt<1>(i));
 	}
+	//the range is detached before the actions run, so actions may access the store. nothing may escape the callback: drain() would
+	//free the remaining rows without passing them, so the first error is rethrown once all rows are gone
+	std::exception_ptr error;
+	_store.eraseRange(l, u, [this, &error](const std::tuple<QByteArray, Value*> &row) {
+		Value *value = std::get<1>(row);
+		try {
+			if(!deferred())
+				actionErase(std::get<0>(row), value);
+			publish(std::get<0>(row), nullptr);
+		}
+		catch(...) {
+			if(!error)
+				error = std::current_exception();
+		}
+		value->decl()->destroy(value);
+	});
+	if(error)
+		std::rethrow_exception(error);
+	if(!deferred())
+		saveIds();
 }
 
 quint64 AbstractDirFrontend::acquire(const DeclType *type)
@@ -148,9 +829,149 @@ quint64 AbstractDirFrontend::acquire(const DeclType *type)
 		_nextid[type->dynamicId - 1]--;
 		throw FrontendException("cannot acquire id: id too big for datatype");
 	}
+	_idsDirty = true;
+	return id;
+}
+
+quint64 AbstractDirFrontend::lastId(const DeclType *type) const
+{
+	if(!type->dynamicId || type->dynamicId > size_t(_nextid.size()))
+		return 0;
+	return _nextid[type->dynamicId - 1];
+}
+
+void AbstractDirFrontend::reserveId(const DeclType *type, quint64 id)
+{
+	if(!type->dynamicId || type->dynamicId > size_t(_nextid.size()))
+		throw FrontendException("type is not used as dynamic id");
+	else if(id > _nextid[type->dynamicId - 1]) {
+		_nextid[type->dynamicId - 1] = id;
+		_idsDirty = true;
+	}
+}
+
+quint64 AbstractDirFrontend::acquire(const DeclType *type, const QString &path)
+{
+	//a path loaded again (e.g. a letter faulted in after eviction) takes its own id again; only other paths collide
+	auto it = _ids.constFind(path);
+	if(it != _ids.constEnd()) {
+		auto taken = _idsTaken.constFind(it.value());
+		if(taken == _idsTaken.constEnd() || taken.value() == path) {
+			_idsTaken.insert(it.value(), path);
+			return it.value();
+		}
+	}
+	quint64 id = acquire(type);
+	_idsTaken.insert(id, path);
+	bindId(path, id);
 	return id;
 }
 
+void AbstractDirFrontend::bindId(const QString &path, quint64 id)
+{
+	auto it = _ids.find(path);
+	if(it == _ids.end() || it.value() != id) {
+		_ids.insert(path, id);
+		_idsDirty = true;
+	}
+	_idsTaken.insert(id, path); //e.g. a markup rebased to new coordinates: reloading the new path must find its own id
+}
+
+void AbstractDirFrontend::unbindId(const QString &path, bool children)
+{
+	auto it = _ids.find(path);
+	if(it != _ids.end()) {
+		untakeId(it.value(), path);
+		_ids.erase(it);
+		_idsDirty = true;
+	}
+	if(children) {
+		QString prefix = path + '/';
+		for(it = _ids.lowerBound(prefix); it != _ids.end() && it.key().startsWith(prefix);) {
+			untakeId(it.value(), it.key());
+			it = _ids.erase(it);
+			_idsDirty = true;
+		}
+	}
+}
+
+void AbstractDirFrontend::untakeId(quint64 id, const QString &path)
+{
+	auto it = _idsTaken.find(id);
+	if(it != _idsTaken.end() && it.value() == path)
+		_idsTaken.erase(it);
+}
+
+void AbstractDirFrontend::loadIds()
+{
+	_ids.clear();
+	_idsTaken.clear();
+	_idsDirty = false;
+	QFile file(_rootdir.absoluteFilePath(IdMapFile));
+	if(!file.open(QFile::ReadOnly))
+		return;
+	QTextStream stream(&file);
+	stream.setCodec("UTF-8");
+	for(;;) {
+		QString line = stream.readLine();
+		if(line.isNull())
+			break;
+		bool ok;
+		QString cmd = line.section(' ', 0, 0);
+		QString arg = line.section(' ', 1, 1);
+		QString rest = line.section(' ', 2);
+		//malformed lines (e.g. left over from a merge) only cost the stability of some ids, so they are skipped
+		if(cmd == "next") {
+			quint64 next = rest.toULongLong(&ok);
+			for(int i = 0; ok && i < _nextid.size(); i++)
+				if(arg == spec()->idTypes[i]->fullname)
+					_nextid[i] = qMax(_nextid[i], next);
+		}
+		else if(cmd == "id") {
+			quint64 id = arg.toULongLong(&ok);
+			if(ok && id && !rest.isEmpty())
+				_ids.insert(rest, id);
+		}
+	}
+}
+
+void AbstractDirFrontend::pruneIds()
+{
+	//drop paths, which have not been loaded; keep those below a loaded path, as their owner may not have been loaded completely (lazy mode)
+	for(auto it = _ids.begin(); it != _ids.end();) {
+		bool keep = _idsTaken.contains(it.value());
+		for(int pos = it.key().lastIndexOf('/'); !keep && pos > 0; pos = it.key().lastIndexOf('/', pos - 1)) {
+			auto parent = _ids.constFind(it.key().left(pos));
+			keep = parent != _ids.constEnd() && _idsTaken.contains(parent.value());
+		}
+		if(keep)
+			++it;
+		else {
+			it = _ids.erase(it);
+			_idsDirty = true;
+		}
+	}
+}
+
+void AbstractDirFrontend::saveIds()
+{
+	if(!_idsDirty)
+		return;
+	QSaveFile file(_rootdir.absoluteFilePath(IdMapFile));
+	if(!file.open(QFile::WriteOnly))
+		throw FrontendException("Error opening id map file");
+	QTextStream stream(&file);
+	stream.setCodec("UTF-8");
+	for(int i = 0; i < _nextid.size(); i++)
+		stream << "next " << spec()->idTypes[i]->fullname << " " << _nextid[i] << "\n";
+	for(auto it = _ids.constBegin(); it != _ids.constEnd(); ++it)
+		stream << "id " << it.value() << " " << it.key() << "\n";
+	stream.flush();
+	if(!file.commit())
+		throw FrontendException("Error writing id map file");
+	_idsDirty = false;
+}
+
 size_t AbstractDirFrontend::size() const
 {
 	return _store.size();
@@ -167,20 +988,30 @@ Value *AbstractDirFrontend::value(size_t pos)
 {
 	if(pos >= _store.size())
 		return nullptr;
-	return _store.cellAt<1>(pos);
+	Value *v = _store.cellAt<1>(pos);
+	journal(_store.cellAt<0>(pos), v);
+	return v;
 }
 
 size_t AbstractDirFrontend::lower(const QByteArray &prefix)
 {
+	fault(prefix);
 	return _store.lower(prefix).index();
 }
 
 size_t AbstractDirFrontend::upper(const QByteArray &key)
 {
+	fault(key);
 	return _store.upper(key).index();
 }
 	
 size_t AbstractDirFrontend::prefixUpper(const QByteArray &prefix)
+{
+	fault(prefix);
+	return storeUpper(prefix);
+}
+
+size_t AbstractDirFrontend::storeUpper(const QByteArray &prefix) const
 {
 	QByteArray tmp = prefix;
 	while(!tmp.isEmpty()) {
@@ -198,39 +1029,71 @@ size_t AbstractDirFrontend::prefixUpper(const QByteArray &prefix)
 
 bool AbstractDirFrontend::contains(const QByteArray &key)
 {
+	fault(key);
 	return _store.contains(key);
 }
 
 void AbstractDirFrontend::foreachKV(const std::function<void(const QByteArray &key, const Value *value)> &fn)
 {
+	ScanGuard guard(this);
 	for(auto it = _store.all(); !it.atEnd(); it.next())
 		fn(it.cell<0>(), it.cell<1>());
 }
 
-void AbstractDirFrontend::dump() const
+bool AbstractDirFrontend::fingerprint(size_t l, size_t u, quint64 *hash)
 {
-	Value::ConstWalker walker;
-	QStack<Name> names;
-	walker.down = [&](Name name, size_t n) {
-		names.push(name);
-	};
-	walker.up = [&](){ names.pop(); };
-	walker.begin = [&](size_t index, const ValueAccessor *accessor, const void *handle) {
-		for(size_t i = 0; i < size_t(names.size() + 1); i++)
-			printf("  ");
-		printf("%s[%zu]\n", qPrintable(name2string(names.top())), index);
-	};
-	walker.var = [&](size_t index, const DeclType *type, const void *handle) {
-		for(size_t i = 0; i < size_t(names.size() + 1); i++)
-			printf("  ");
-		const char *quot = type->isString() ? "'" : "";
-		printf("%s[%zu] = %s%s%s\n", qPrintable(name2string(names.top())), index, quot, qPrintable(type->tostring(handle)), quot);
+	rehash();
+	*hash = _store.hashRange(l, qMin(u, _store.size()));
+	return true;
+}
+
+void AbstractDirFrontend::rehash()
+{
+	for(auto key : _stale) {
+		auto it = _store.single(key);
+		if(!it.atEnd())
+			_store.setHashAt(it.index(), entryHash(key, it.cell<1>()));
+	}
+	_stale.clear();
+}
+
+namespace {
+	struct DumpVisitor {
+		QStack<Name> names;
+
+		void down(Name name, size_t n) {
+			names.push(name);
+		}
+
+		void up() {
+			names.pop();
+		}
+
+		void begin(size_t index) {
+			for(size_t i = 0; i < size_t(names.size() + 1); i++)
+				printf("  ");
+			printf("%s[%zu]\n", qPrintable(name2string(names.top())), index);
+		}
+
+		void end() {}
+
+		template<typename T> void var(size_t index, const DeclType *type, const T &value) {
+			for(size_t i = 0; i < size_t(names.size() + 1); i++)
+				printf("  ");
+			const char *quot = type->isString() ? "'" : "";
+			printf("%s[%zu] = %s%s%s\n", qPrintable(name2string(names.top())), index, quot, qPrintable(type->tostring(&value)), quot);
+		}
 	};
+}
+
+void AbstractDirFrontend::dump() const
+{
+	DumpVisitor visitor;
 	printf("MemoryFrontend dump\n");
 	printf("  store: %zu\n", _store.size());
 	for(auto it = _store.all(); !it.atEnd(); it.next()) {
 		qHexdump(it.cell<0>(), "    ");
-		it.cell<1>()->constWalk(walker);
+		walk(*it.cell<1>(), visitor);
 		printf("\n");
 	}
 	printf("  dynamic ids: %d\n", _nextid.size());
@@ -238,11 +1101,29 @@ void AbstractDirFrontend::dump() const
 		printf("    %s: %llu\n", spec()->idTypes[i]->fullname, _nextid[i]);
 }
 
+Value *AbstractDirFrontend::peek(const QByteArray &key) const
+{
+	return _store.cell<1>(key);
+}
+
+void AbstractDirFrontend::unload(const QByteArray &prefix)
+{
+	_store.eraseRange(_store.lower(prefix).index(), storeUpper(prefix), [](const std::tuple<QByteArray, Value*> &row) {
+		std::get<1>(row)->decl()->destroy(std::get<1>(row));
+	});
+}
+
 void AbstractDirFrontend::put(const QByteArray &key, Value *value)
 {
-	Value *cur = _store.cell<1>(key);
-	if(cur)
-		delete cur;
-	_store.put(key, value);
+	if(_bulkLoading)
+		_bulk.emplace_back(key, value);
+	else {
+		Value *cur = _store.cell<1>(key);
+		if(cur)
+			cur->decl()->destroy(cur);
+		_store.put(key, value);
+	}
+	_stale.insert(key);
+	publish(key, value);
 }
 
@@ -0,0 +1,281 @@
+#include <QSaveFile>
+
+#include <string.h>
+
+#include "key.h"
+#include "frontend.h"
+
+using namespace spec;
+
+static const char *LogFile = "data.log";
+static const char LogMagic[8] = { 'Q', 'A', 'L', 'O', 'G', 0, 0, 2 };
+static const qint64 LogHeaderSize = sizeof(LogMagic);
+static const quint64 CompactMinGarbage = 4 * 1024 * 1024; //don't rewrite small logs
+
+//record: u32 length of the remainder, u64 checksum of everything after it, u8 op, u16 key length, key, framed value (Value::toBinary(); put only)
+enum LogOp {
+	OpPut = 1,
+	OpErase = 2
+};
+
+static const size_t RecordHeaderSize = 4 + 8 + 1 + 2;
+static const size_t RecordChecked = 4 + 8; //offset of the checksummed part
+static const size_t RecordKeyLength = 4 + 8 + 1; //offset of the key length
+
+namespace {
+	quint64 checksum(const char *data, size_t size)
+	{
+		ValueHasher hasher;
+		hasher.put(QByteArray::fromRawData(data, int(size)));
+		return hasher.result();
+	}
+}
+
+namespace {
+	QByteArray record(LogOp op, const QByteArray &key, const Value *value)
+	{
+		if(key.size() > 0xffff)
+			throw FrontendException("cannot write log record: key too long");
+		QByteArray data = value ? value->toBinary() : QByteArray();
+		QByteArray result;
+		result.reserve(RecordHeaderSize + key.size() + data.size());
+		BinaryWriter writer(&result);
+		writer.put(quint32(8 + 1 + 2 + key.size() + data.size()));
+		writer.put(quint64(0)); //checksum, filled in below
+		writer.put(quint8(op));
+		writer.put(quint16(key.size()));
+		result.append(key);
+		result.append(data);
+		quint64 sum = checksum(result.constData() + RecordChecked, result.size() - RecordChecked);
+		qToLittleEndian<quint64>(sum, reinterpret_cast<uchar*>(result.data() + 4));
+		return result;
+	}
+}
+
+LogFrontend::LogFrontend(const DeclMeta *spec, const QDir &dir)
+	:	AbstractDirFrontend(spec, dir),
+		_map(nullptr),
+		_mapSize(0),
+		_garbage(0)
+{
+	_file.setFileName(dir.absoluteFilePath(LogFile));
+}
+
+LogFrontend::~LogFrontend()
+{
+	close();
+}
+
+quint64 LogFrontend::garbage() const
+{
+	return _garbage;
+}
+
+void LogFrontend::open()
+{
+	close();
+	if(!_file.open(QFile::ReadWrite))
+		throw FrontendException("Error opening log file");
+	if(!_file.size()) {
+		if(_file.write(LogMagic, LogHeaderSize) != LogHeaderSize || !_file.flush())
+			throw FrontendException("Error writing log file");
+	}
+	_mapSize = _file.size();
+	_map = _file.map(0, _mapSize);
+	if(!_map)
+		throw FrontendException("Error mapping log file");
+	else if(_mapSize < LogHeaderSize || memcmp(_map, LogMagic, LogHeaderSize))
+		throw FrontendException("Invalid log file");
+}
+
+void LogFrontend::close()
+{
+	if(_map)
+		_file.unmap(_map);
+	_map = nullptr;
+	_mapSize = 0;
+	if(_file.isOpen())
+		_file.close();
+}
+
+void LogFrontend::actionLoad()
+{
+	open();
+	_index.clear();
+	_garbage = 0;
+
+	qint64 pos = LogHeaderSize;
+	while(pos + qint64(RecordHeaderSize) <= _mapSize) {
+		BinaryReader reader(spec(), reinterpret_cast<const char*>(_map + pos), _mapSize - pos);
+		quint32 length;
+		quint64 sum;
+		quint8 op;
+		quint16 keylen;
+		reader.get(length);
+		reader.get(sum);
+		reader.get(op);
+		reader.get(keylen);
+		if(length < 11u + keylen || pos + 4 + length > _mapSize || (op != OpPut && op != OpErase))
+			break;
+		else if(checksum(reinterpret_cast<const char*>(_map + pos + RecordChecked), length - 8) != sum) //e.g. a length, which landed before its zero filled payload
+			break;
+		QByteArray key(reinterpret_cast<const char*>(_map + pos + RecordHeaderSize), keylen);
+		auto it = _index.find(key);
+		if(it != _index.end()) {
+			_garbage += it->size;
+			_index.erase(it);
+		}
+		if(op == OpPut) {
+			Extent extent;
+			extent.offset = pos;
+			extent.size = 4 + length;
+			extent.hash = 0;
+			extent.loaded = false;
+			_index.insert(key, extent);
+		}
+		else
+			_garbage += 4 + length;
+		pos += 4 + length;
+	}
+
+	if(pos < _mapSize) { //drop the torn or corrupt tail of an interrupted write, like replayJournal() does
+		qWarning("log file: dropping %lld bytes of incomplete or corrupt records", _mapSize - pos);
+		_file.unmap(_map);
+		_map = nullptr;
+		if(!_file.resize(pos))
+			throw FrontendException("Error truncating log file");
+		_mapSize = pos;
+		_map = _file.map(0, _mapSize);
+		if(!_map)
+			throw FrontendException("Error mapping log file");
+	}
+
+	if(!isLazy())
+		actionFault(QByteArray());
+}
+
+void LogFrontend::actionFault(const QByteArray &prefix)
+{
+	for(auto it = _index.lowerBound(prefix); it != _index.end() && it.key().startsWith(prefix); ++it) {
+		if(it->loaded)
+			continue;
+		Value *value = decode(*it);
+		put(it.key(), value);
+		it->hash = value->contentHash();
+		it->loaded = true;
+	}
+}
+
+Value *LogFrontend::decode(const Extent &extent) const
+{
+	const uchar *rec = _map + extent.offset;
+	quint16 keylen = rec[RecordKeyLength] | rec[RecordKeyLength + 1] << 8;
+	size_t head = RecordHeaderSize + keylen;
+	Value *value = Value::fromBinary(spec(), reinterpret_cast<const char*>(rec + head), extent.size - head);
+	if(!value)
+		throw FrontendException("Invalid record in log file");
+	return value;
+}
+
+void LogFrontend::actionSave()
+{
+	compact();
+}
+
+void LogFrontend::append(const QByteArray &record)
+{
+	if(!_file.seek(_file.size()) || _file.write(record) != record.size() || !_file.flush())
+		throw FrontendException("Error writing log file");
+}
+
+void LogFrontend::sync()
+{
+	if(!syncFile(_file))
+		throw FrontendException("Error syncing log file");
+}
+
+void LogFrontend::write(const QByteArray &key, Value *value)
+{
+	quint64 hash = value->contentHash();
+	auto it = _index.find(key);
+	if(it != _index.end()) {
+		if(it->loaded && it->hash == hash)
+			return;
+		_garbage += it->size;
+	}
+	QByteArray data = record(OpPut, key, value);
+	Extent extent;
+	extent.offset = _file.size();
+	extent.size = data.size();
+	extent.hash = hash;
+	extent.loaded = true;
+	append(data);
+	_index.insert(key, extent);
+}
+
+void LogFrontend::actionModify(const QByteArray &key, Value *value)
+{
+	write(key, value);
+	//editors change rows in place and only mark the owning key, so rows referencing its ids are checked as well
+	for(const auto &prefix : ownedPrefixes(key, value)) {
+		size_t l;
+		size_t u;
+		prefixRange(&l, &u, prefix);
+		for(; l < u; l++)
+			write(this->key(l), peek(this->key(l)));
+	}
+	sync();
+	compactIfWasteful();
+}
+
+void LogFrontend::actionErase(const QByteArray &key, Value *value)
+{
+	auto it = _index.find(key);
+	if(it == _index.end())
+		return;
+	QByteArray data = record(OpErase, key, nullptr);
+	append(data);
+	_garbage += it->size + data.size();
+	_index.erase(it);
+	sync();
+	compactIfWasteful();
+}
+
+void LogFrontend::compactIfWasteful()
+{
+	quint64 total = _file.size() - LogHeaderSize;
+	if(_garbage >= CompactMinGarbage && _garbage * 2 > total)
+		compact();
+}
+
+void LogFrontend::compact()
+{
+	actionFault(QByteArray()); //the rewritten log is built from memory, so everything has to be resident
+
+	QMap<QByteArray, Extent> index;
+	QSaveFile out(_file.fileName());
+	if(!out.open(QFile::WriteOnly) || out.write(LogMagic, LogHeaderSize) != LogHeaderSize)
+		throw FrontendException("Error writing log file");
+	qint64 pos = LogHeaderSize;
+	for(size_t i = 0; i < size(); i++) {
+		QByteArray key = this->key(i);
+		Value *value = peek(key);
+		QByteArray data = record(OpPut, key, value);
+		if(out.write(data) != data.size())
+			throw FrontendException("Error writing log file");
+		Extent extent;
+		extent.offset = pos;
+		extent.size = data.size();
+		extent.hash = value->contentHash();
+		extent.loaded = true;
+		index.insert(key, extent);
+		pos += data.size();
+	}
+	close();
+	bool ok = out.commit();
+	open();
+	if(!ok)
+		throw FrontendException("Error writing log file");
+	_index.swap(index);
+	_garbage = 0;
+}
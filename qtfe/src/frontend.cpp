@@ -1,3 +1,5 @@
+#include <exception>
+
 #include "key.h"
 #include "frontend.h"
 
@@ -10,23 +12,597 @@ Frontend::Frontend(const DeclMeta *spec)
 		throw FrontendException("cannot create frontend: missing spec");
 }
 
+size_t FrontendSnapshot::size() const
+{
+	return _map.size();
+}
+
+QByteArray FrontendSnapshot::key(size_t pos) const
+{
+	if(pos >= _map.size())
+		return QByteArray();
+	return _map.keyAt(pos);
+}
+
+const Value *FrontendSnapshot::value(size_t pos) const
+{
+	if(pos >= _map.size())
+		return nullptr;
+	return _map.valueAt(pos).data();
+}
+
+const Value *FrontendSnapshot::get(const QByteArray &key) const
+{
+	const QSharedPointer<const Value> *value = _map.find(key);
+	return value ? value->data() : nullptr;
+}
+
+bool FrontendSnapshot::contains(const QByteArray &key) const
+{
+	return _map.contains(key);
+}
+
+size_t FrontendSnapshot::lower(const QByteArray &prefix) const
+{
+	return _map.lower(prefix);
+}
+
+size_t FrontendSnapshot::upper(const QByteArray &key) const
+{
+	return _map.upper(key);
+}
+
+size_t FrontendSnapshot::prefixUpper(const QByteArray &prefix) const
+{
+	QByteArray tmp = prefix;
+	while(!tmp.isEmpty()) {
+		uint8_t last = tmp.at(tmp.size() - 1);
+		if(last < 0xff) {
+			last++;
+			tmp[tmp.size() - 1] = last;
+			return _map.lower(tmp);
+		}
+		else
+			tmp.chop(1);
+	}
+	return _map.size();
+}
+
+void FrontendSnapshot::foreachKV(const std::function<void(const QByteArray &key, const Value *value)> &fn) const
+{
+	_map.foreachRange(0, _map.size(), [&fn](const QByteArray &key, const QSharedPointer<const Value> &value) {
+		fn(key, value.data());
+		return true;
+	});
+}
+
 void SyncFrontend::modified(const QByteArray &key)
 {}
 
-void SyncFrontend::diff(SyncFrontend *a, SyncFrontend *b, const std::function<void(const QByteArray&, Value*, const QByteArray&, Value*)> &cb)
+void SyncFrontend::insert(const QByteArray &key, Value *value)
+{
+	//generic path: copy into the frontend's own value
+	const DeclValue *decl = value->decl();
+	try {
+		Value *dst = get(key, true);
+		if(dst->decl() != decl)
+			throw FrontendException("cannot insert value: type mismatch");
+		QByteArray data;
+		BinaryWriter writer(&data);
+		value->serialize(writer);
+		BinaryReader reader(spec(), data.constData(), data.size());
+		if(!dst->deserialize(reader))
+			throw FrontendException("cannot insert value: malformed data");
+	}
+	catch(...) {
+		decl->destroy(value);
+		throw;
+	}
+	decl->destroy(value);
+	modified(key);
+}
+
+void SyncFrontend::pin(const QByteArray &key)
+{}
+
+quint64 SyncFrontend::lastId(const DeclType *type) const
+{
+	return 0;
+}
+
+void SyncFrontend::reserveId(const DeclType *type, quint64 id)
 {}
 
+void SyncFrontend::unpin(const QByteArray &key)
+{}
+
+void SyncFrontend::beginScan()
+{}
+
+void SyncFrontend::endScan()
+{}
+
+bool SyncFrontend::fingerprint(size_t l, size_t u, quint64 *hash)
+{
+	return false;
+}
+
+quint64 SyncFrontend::entryHash(const QByteArray &key, const Value *value)
+{
+	ValueHasher hasher(value->contentHash());
+	hasher.put(key);
+	return hasher.result();
+}
+
+namespace {
+	typedef std::function<void(const QByteArray&, Value*, const QByteArray&, Value*)> DiffCallback;
+
+	const size_t DiffLinearRange = 32; //ranges up to this size are merge-walked directly
+
+	void diffLinear(SyncFrontend *a, size_t la, size_t ua, SyncFrontend *b, size_t lb, size_t ub, const DiffCallback &cb)
+	{
+		while(la < ua && lb < ub) {
+			QByteArray ka = a->key(la);
+			QByteArray kb = b->key(lb);
+			if(ka < kb) {
+				cb(ka, a->value(la), QByteArray(), nullptr);
+				la++;
+			}
+			else if(kb < ka) {
+				cb(QByteArray(), nullptr, kb, b->value(lb));
+				lb++;
+			}
+			else {
+				Value *va = a->value(la);
+				Value *vb = b->value(lb);
+				if(*va != *vb)
+					cb(ka, va, kb, vb);
+				la++;
+				lb++;
+			}
+		}
+		for(; la < ua; la++)
+			cb(a->key(la), a->value(la), QByteArray(), nullptr);
+		for(; lb < ub; lb++)
+			cb(QByteArray(), nullptr, b->key(lb), b->value(lb));
+	}
+
+	//both ranges cover the same key interval; they are split at a common pivot key until they are either identical or small
+	void diffRange(SyncFrontend *a, size_t la, size_t ua, SyncFrontend *b, size_t lb, size_t ub, const DiffCallback &cb)
+	{
+		quint64 ha;
+		quint64 hb;
+		if(ua - la == ub - lb && a->fingerprint(la, ua, &ha) && b->fingerprint(lb, ub, &hb) && ha == hb)
+			return;
+		if(ua - la <= DiffLinearRange || ub - lb <= DiffLinearRange) {
+			diffLinear(a, la, ua, b, lb, ub, cb);
+			return;
+		}
+
+		QByteArray pivot;
+		if(ua - la >= ub - lb)
+			pivot = a->key(la + (ua - la) / 2);
+		else
+			pivot = b->key(lb + (ub - lb) / 2);
+		size_t ma = qBound(la, a->lower(pivot), ua);
+		size_t mb = qBound(lb, b->lower(pivot), ub);
+		diffRange(a, la, ma, b, lb, mb, cb);
+		diffRange(a, ma, ua, b, mb, ub, cb);
+	}
+}
+
+void SyncFrontend::diff(SyncFrontend *a, SyncFrontend *b, const std::function<void(const QByteArray&, Value*, const QByteArray&, Value*)> &cb)
+{
+	if(a->spec() != b->spec())
+		throw FrontendException("cannot diff frontends of different spec versions");
+	//lazy frontends: size(), key() and value() only see resident rows, so both sides are loaded completely for the walk
+	ScanGuard guardA(a);
+	ScanGuard guardB(b);
+	quint64 hash;
+	if(a->fingerprint(0, a->size(), &hash) && b->fingerprint(0, b->size(), &hash))
+		diffRange(a, 0, a->size(), b, 0, b->size(), cb);
+	else
+		diffLinear(a, 0, a->size(), b, 0, b->size(), cb);
+}
+
 SyncFrontend::SyncFrontend(const DeclMeta *spec)
-	:	Frontend(spec)
+	:	Frontend(spec),
+		_txDepth(0),
+		_txRestoring(false),
+		_snapshots(false)
 {}
 
-void SyncFrontend::gc()
+namespace {
+	//snapshots get their own copy; the frontend keeps changing its values in place
+	QSharedPointer<const Value> freeze(const Value *value)
+	{
+		const DeclValue *decl = value->decl();
+		return QSharedPointer<const Value>(value->clone(), [decl](const Value *v) {
+			decl->destroy(const_cast<Value*>(v));
+		});
+	}
+}
+
+FrontendSnapshot SyncFrontend::snapshot()
+{
+	QSharedPointer<FrontendSnapshot::Lease> lease = _lease.toStrongRef();
+	if(!lease) {
+		if(!_snapshots) { //otherwise, the last snapshot has been released without a change since: '_published' is still current
+			ScanGuard guard(this);
+			foreachKV([this](const QByteArray &key, const Value *value) {
+				_published.put(key, freeze(value));
+			});
+			_snapshots = true;
+		}
+		lease.reset(new FrontendSnapshot::Lease());
+		_lease = lease;
+	}
+	return FrontendSnapshot(spec(), _published, lease);
+}
+
+void SyncFrontend::publish(const QByteArray &key, const Value *value)
+{
+	if(!_snapshots)
+		return;
+	else if(_lease.isNull()) { //no snapshot alive anymore: release the copy instead of maintaining it
+		_snapshots = false;
+		_published = FrontendSnapshot::Map();
+	}
+	else if(value)
+		_published.put(key, freeze(value));
+	else
+		_published.remove(key);
+}
+
+void SyncFrontend::begin()
+{
+	_txDepth++;
+}
+
+void SyncFrontend::commit()
+{
+	if(!_txDepth)
+		throw FrontendException("cannot commit: no transaction");
+	else if(--_txDepth)
+		return;
+	QList<QByteArray> keys;
+	QHash<QByteArray, TxEntry> before;
+	keys.swap(_txKeys);
+	before.swap(_txBefore);
+	txFlush(keys, before);
+}
+
+void SyncFrontend::rollback()
+{
+	if(!_txDepth)
+		throw FrontendException("cannot rollback: no transaction");
+	_txRestoring = true;
+	try {
+		//newest first, so moves are undone before their source keys are restored
+		for(int i = _txKeys.size() - 1; i >= 0; i--) {
+			const QByteArray &key = _txKeys.at(i);
+			const TxEntry &entry = _txBefore[key];
+			if(!entry.existed) {
+				if(contains(key))
+					erase(key);
+				continue;
+			}
+			Value *value = get(key, true);
+			BinaryReader reader(spec(), entry.data.constData(), entry.data.size());
+			if(!value->deserialize(reader))
+				throw FrontendException("cannot rollback: malformed journal entry");
+			modified(key);
+		}
+	}
+	catch(...) {
+		_txRestoring = false;
+		throw;
+	}
+	_txRestoring = false;
+	_txDepth = 0;
+	_txKeys.clear();
+	_txBefore.clear();
+}
+
+bool SyncFrontend::inTransaction() const
+{
+	return _txDepth > 0;
+}
+
+void SyncFrontend::journal(const QByteArray &key, const Value *value)
+{
+	if(!_txDepth || _txRestoring || _txBefore.contains(key))
+		return;
+	TxEntry entry;
+	entry.existed = value;
+	entry.modified = false;
+	if(value) {
+		BinaryWriter writer(&entry.data);
+		value->serialize(writer);
+	}
+	_txBefore.insert(key, entry);
+	_txKeys.append(key);
+}
+
+void SyncFrontend::journalModified(const QByteArray &key, const Value *value)
+{
+	if(!_txDepth || _txRestoring)
+		return;
+	journal(key, value);
+	_txBefore[key].modified = true;
+}
+
+bool SyncFrontend::changedSince(const QByteArray &key, const TxEntry &entry, Value *value) const
+{
+	if(!value || !entry.existed)
+		return value || entry.existed;
+	QByteArray data;
+	BinaryWriter writer(&data);
+	value->serialize(writer);
+	return data != entry.data;
+}
+
+Value *SyncFrontend::decode(const QByteArray &key, const TxEntry &entry) const
+{
+	const DeclValue *mapto = KeyEditor(spec(), key).mapto();
+	if(!mapto)
+		throw FrontendException("cannot decode journal entry: key does not map to a value");
+	Value *value = static_cast<Value*>(mapto->create());
+	BinaryReader reader(spec(), entry.data.constData(), entry.data.size());
+	if(!value->deserialize(reader)) {
+		mapto->destroy(value);
+		throw FrontendException("cannot decode journal entry: malformed data");
+	}
+	return value;
+}
+
+void SyncFrontend::txFlush(const QList<QByteArray> &keys, const QHash<QByteArray, TxEntry> &before)
 {}
 
+namespace {
+	void collectIds(const DeclValue *decl, const ValueAccessor *accessor, const void *handle, size_t base, const size_t *path, size_t n, QSet<quint64> &ids)
+	{
+		const DeclVar *var = decl->vars + base + *path;
+		size_t count = accessor->size(handle, *path);
+		for(size_t k = 0; k < count; k++) {
+			const void *child = accessor->constChild(handle, *path, k);
+			if(n == 1)
+				ids.insert(var->u.type->uintGet(child));
+			else
+				collectIds(decl, var->u.accessor, child, var->child, path + 1, n - 1, ids);
+		}
+	}
+
+	quint64 fieldValue(const QByteArray &key, const DeclField *field)
+	{
+		quint64 result = 0;
+		for(size_t i = 0; i < field->type->size; i++)
+			result = result << 8 | quint8(key.at(field->offset + i));
+		return result;
+	}
+
+	void appendField(QByteArray &key, const DeclField *field, quint64 value)
+	{
+		for(size_t i = field->type->size; i > 0; i--)
+			key.append(char(value >> (8 * (i - 1))));
+	}
+
+	//prefix of all rows of 'ref' referencing a single id; empty, if the id field does not directly follow the key type
+	QByteArray refBase(const DeclDynidRef *ref)
+	{
+		QByteArray base = KeyEditor(ref->key);
+		if(size_t(base.size()) != ref->key->fields[ref->field].offset)
+			return QByteArray();
+		return base;
+	}
+
+	bool belongsTo(const DeclMeta *meta, const QByteArray &key, const DeclKey *decl)
+	{
+		if(!decl->abstract && !decl->nSubKeys)
+			return true;
+		KeyEditor keyed(meta, key);
+		return keyed.decl() == decl;
+	}
+}
+
+SyncFrontend::GcStats SyncFrontend::gc()
+{
+	GcStats stats;
+	ScanGuard guard(this); //the live ids have to be collected from all owners, evicted ones included
+	QList<QPair<const DeclDynid*, QByteArray>> owners; //owners with references and their key prefix
+	for(size_t t = 0; t < spec()->nIdTypes; t++)
+		for(size_t o = 0; o < spec()->idTypes[t]->nOwners; o++) {
+			const DeclDynid *owner = spec()->idTypes[t]->owners + o;
+			if(owner->nRefs)
+				owners.append(qMakePair(owner, QByteArray(KeyEditor(owner->key))));
+		}
+	//the sweep is one transaction: journaled frontends write a single batch, and a failure leaves all rows in place
+	begin();
+	try {
+		bool changed = true;
+		//erasing orphans may orphan further rows (e.g. comments of a removed content), so sweep until nothing is left
+		while(changed) {
+			changed = false;
+
+			//live ids of all owners: one read-only pass, so owner values are not journaled. sets collected before an erasure of the same
+			//round may contain ids, which are no longer live; the next round catches their orphans
+			QHash<const DeclDynid*, QSet<quint64>> liveIds;
+			foreachKV([&](const QByteArray &k, const Value *v) {
+				for(const auto &it : owners) {
+					const DeclDynid *owner = it.first;
+					if(!k.startsWith(it.second) || !belongsTo(spec(), k, owner->key))
+						continue;
+					else if(owner->type == DeclDynid::FieldType)
+						liveIds[owner].insert(fieldValue(k, owner->key->fields + owner->u.field));
+					else if(v->decl() == owner->u.value.decl && owner->u.value.nVarpath)
+						collectIds(v->decl(), v->decl()->accessor, v, 0, owner->u.value.varpath, owner->u.value.nVarpath, liveIds[owner]);
+				}
+			});
+
+			for(const auto &it : owners) {
+				const DeclDynid *owner = it.first;
+				const QSet<quint64> live = liveIds.value(owner);
+				size_t l;
+				size_t u;
+
+				//sweep: rows sharing all key fields up to the id field form a run, which is erased at once
+				for(size_t r = 0; r < owner->nRefs; r++) {
+					const DeclDynidRef *ref = owner->refs + r;
+					const DeclField *field = ref->key->fields + ref->field;
+					prefixRange(&l, &u, KeyEditor(ref->key));
+					size_t pos = l;
+					while(pos < u) {
+						QByteArray k = key(pos);
+						quint64 id = 0;
+						if(size_t(k.size()) >= field->offset + field->type->size && belongsTo(spec(), k, ref->key))
+							id = fieldValue(k, field);
+						if(!id || live.contains(id)) { //0: null id
+							pos++;
+							continue;
+						}
+						QByteArray run = k.left(field->offset + field->type->size);
+						size_t end = prefixUpper(run);
+						for(size_t i = pos; i < end; i++) {
+							stats.values++;
+							stats.bytes += key(i).size() + value(i)->serialSize();
+						}
+						prefixErase(run);
+						u -= end - pos;
+						changed = true;
+					}
+				}
+			}
+		}
+	}
+	catch(...) {
+		rollback();
+		throw;
+	}
+	commit();
+	return stats;
+}
+
+QList<QByteArray> SyncFrontend::ownedPrefixes(const QByteArray &key, const Value *value) const
+{
+	QList<QByteArray> result;
+	for(size_t t = 0; t < spec()->nIdTypes; t++) {
+		const DeclType *type = spec()->idTypes[t];
+		for(size_t o = 0; o < type->nOwners; o++) {
+			const DeclDynid *owner = type->owners + o;
+			if(!owner->nRefs || !key.startsWith(KeyEditor(owner->key)) || !belongsTo(spec(), key, owner->key))
+				continue;
+			QSet<quint64> ids;
+			if(owner->type == DeclDynid::FieldType) {
+				const DeclField *field = owner->key->fields + owner->u.field;
+				if(size_t(key.size()) >= field->offset + field->type->size)
+					ids.insert(fieldValue(key, field));
+			}
+			else if(value && value->decl() == owner->u.value.decl && owner->u.value.nVarpath)
+				collectIds(value->decl(), value->decl()->accessor, value, 0, owner->u.value.varpath, owner->u.value.nVarpath, ids);
+			ids.remove(0);
+			for(size_t r = 0; r < owner->nRefs; r++) {
+				QByteArray base = refBase(owner->refs + r);
+				if(base.isEmpty())
+					continue;
+				for(auto id : ids) {
+					QByteArray prefix = base;
+					appendField(prefix, owner->refs[r].key->fields + owner->refs[r].field, id);
+					result.append(prefix);
+				}
+			}
+		}
+	}
+	return result;
+}
+
+void SyncFrontend::mirror(SyncFrontend *source, SyncFrontend *target)
+{
+	if(source->spec() != target->spec())
+		throw FrontendException("cannot mirror frontends: specs differ");
+	const DeclMeta *meta = source->spec();
+	for(size_t t = 0; t < meta->nIdTypes; t++)
+		target->reserveId(meta->idTypes[t], source->lastId(meta->idTypes[t]));
+
+	QList<QPair<QByteArray, QByteArray>> changed; //key, serialized value
+	QList<QByteArray> removed;
+	diff(source, target, [&](const QByteArray &ka, Value *va, const QByteArray &kb, Value *vb) {
+		if(ka.isEmpty()) {
+			removed.append(kb);
+			return;
+		}
+		QByteArray data;
+		BinaryWriter writer(&data);
+		va->serialize(writer);
+		changed.append(qMakePair(ka, data));
+	});
+	if(changed.isEmpty() && removed.isEmpty())
+		return;
+
+	target->begin();
+	try {
+		for(const auto &key : removed)
+			target->erase(key);
+		for(const auto &it : changed) {
+			Value *value = target->get(it.first, true);
+			BinaryReader reader(meta, it.second.constData(), it.second.size());
+			if(!value->deserialize(reader))
+				throw FrontendException("cannot mirror value: malformed data");
+			target->modified(it.first);
+		}
+
+		//directory based frontends persist whole objects, so the owners of changed rows are marked as well
+		QHash<QByteArray, QByteArray> owners; //owned prefix -> owner key
+		for(size_t t = 0; t < meta->nIdTypes; t++) {
+			const DeclType *type = meta->idTypes[t];
+			for(size_t o = 0; o < type->nOwners; o++) {
+				if(!type->owners[o].nRefs)
+					continue;
+				size_t l;
+				size_t u;
+				target->prefixRange(&l, &u, KeyEditor(type->owners[o].key));
+				for(; l < u; l++) {
+					QByteArray key = target->key(l);
+					for(const auto &prefix : target->ownedPrefixes(key, target->value(l)))
+						owners.insert(prefix, key);
+				}
+			}
+		}
+		QSet<QByteArray> marked;
+		auto mark = [&](const QByteArray &key) {
+			for(size_t t = 0; t < meta->nIdTypes; t++) {
+				const DeclType *type = meta->idTypes[t];
+				for(size_t o = 0; o < type->nOwners; o++)
+					for(size_t r = 0; r < type->owners[o].nRefs; r++) {
+						const DeclDynidRef *ref = type->owners[o].refs + r;
+						const DeclField *field = ref->key->fields + ref->field;
+						QByteArray base = refBase(ref);
+						if(base.isEmpty() || !key.startsWith(base) || size_t(key.size()) < field->offset + field->type->size)
+							continue;
+						QByteArray owner = owners.value(key.left(field->offset + field->type->size));
+						if(!owner.isEmpty() && !marked.contains(owner)) {
+							marked.insert(owner);
+							target->modified(owner);
+						}
+					}
+			}
+		};
+		for(const auto &key : removed)
+			mark(key);
+		for(const auto &it : changed)
+			mark(it.first);
+	}
+	catch(...) {
+		target->rollback();
+		throw;
+	}
+	target->commit();
+}
+
 MemoryFrontend::MemoryFrontend(const DeclMeta *spec)
 	:	SyncFrontend(spec)
 {
 	_nextid.resize(spec->nIdTypes);
+	_store.setFinger(true); //editors and loaders mostly access neighbouring keys
 }
 
 MemoryFrontend::~MemoryFrontend()
@@ -38,6 +614,8 @@ MemoryFrontend::~MemoryFrontend()
 Value *MemoryFrontend::get(const QByteArray &key, bool create)
 {
 	Value *v = _store.cell<1>(key);
+	if(v || create)
+		journal(key, v);
 	if(!v && create) {
 		KeyEditor keyed(spec(), key);
 		if(!keyed.isValid(true))
@@ -47,16 +625,49 @@ Value *MemoryFrontend::get(const QByteArray &key, bool create)
 			throw FrontendException("error creating value: key does not map to a value");
 		v = static_cast<Value*>(mapto->create());
 		_store.insert(key, v);
+		_stale.insert(key);
+		publish(key, v);
 	}
 	return v;
 }
 
+void MemoryFrontend::modified(const QByteArray &key)
+{
+	Value *v = _store.cell<1>(key);
+	//editors change rows in place and only mark the owning key, so rows below it and rows referencing its ids are rehashed
+	//and published as well; this includes the key itself
+	QList<QByteArray> prefixes = ownedPrefixes(key, v);
+	prefixes.prepend(key);
+	for(const auto &prefix : prefixes) {
+		size_t u = prefixUpper(prefix);
+		for(size_t l = _store.lower(prefix).index(); l < u; l++) {
+			_stale.insert(_store.cellAt<0>(l));
+			publish(_store.cellAt<0>(l), _store.cellAt<1>(l));
+		}
+	}
+	_stale.insert(key);
+}
+
+void MemoryFrontend::insert(const QByteArray &key, Value *value)
+{
+	Value *cur = _store.cell<1>(key);
+	journal(key, cur);
+	if(cur)
+		cur->decl()->destroy(cur);
+	_store.put(key, value);
+	_stale.insert(key);
+	publish(key, value);
+}
+
 void MemoryFrontend::erase(const QByteArray &key)
 {
+	_stale.remove(key);
 	auto it = _store.single(key);
 	if(!it.atEnd()) {
+		journal(key, it.cell<1>());
 		it.cell<1>()->decl()->destroy(it.cell<1>());
 		_store.removeAt(it.index());
+		publish(key, nullptr);
 	}
 }
 
@@ -67,20 +678,37 @@ void MemoryFrontend::move(const QByteArray &oldkey, const QByteArray &newkey)
 		throw FrontendException("cannot move value: no such value");
 	else if(_store.cell<1>(newkey))
 		throw FrontendException("cannot move value: key already exists");
+	journal(oldkey, value);
+	journal(newkey, nullptr);
 	_store.remove(oldkey);
 	_store.put(newkey, value);
+	_stale.remove(oldkey);
+	_stale.insert(newkey);
+	publish(oldkey, nullptr);
+	publish(newkey, value);
 }
 
 void MemoryFrontend::prefixErase(const QByteArray &prefix)
 {
 	size_t l = lower(prefix);
 	size_t u = prefixUpper(prefix);
-	while(u > l) {
-		Value *value = _store.cellAt<1>(l);
+	for(size_t i = l; i < u; i++)
+		journal(_store.cellAt<0>(i), _store.cellAt<1>(i));
+	//see AbstractDirFrontend::prefixErase(): nothing may escape the callback
+	std::exception_ptr error;
+	_store.eraseRange(l, u, [this, &error](const std::tuple<QByteArray, Value*> &row) {
+		Value *value = std::get<1>(row);
+		try {
+			publish(std::get<0>(row), nullptr);
+		}
+		catch(...) {
+			if(!error)
+				error = std::current_exception();
+		}
 		value->decl()->destroy(value);
-		_store.removeAt(l);
-		u--;
-	}
+	});
+	if(error)
+		std::rethrow_exception(error);
 }
 
 quint64 MemoryFrontend::acquire(const spec::DeclType *type)
@@ -111,7 +739,9 @@ spec::Value *MemoryFrontend::value(size_t pos)
 {
 	if(pos >= _store.size())
 		return nullptr;
-	return _store.cellAt<1>(pos);
+	Value *v = _store.cellAt<1>(pos);
+	journal(_store.cellAt<0>(pos), v);
+	return v;
 }
 
 size_t MemoryFrontend::lower(const QByteArray &prefix)
@@ -124,6 +754,20 @@ size_t MemoryFrontend::upper(const QByteArray &key)
 	return _store.upper(key).index();
 }
 
+quint64 MemoryFrontend::lastId(const DeclType *type) const
+{
+	if(!type->dynamicId || type->dynamicId > size_t(_nextid.size()))
+		return 0;
+	return _nextid[type->dynamicId - 1];
+}
+
+void MemoryFrontend::reserveId(const DeclType *type, quint64 id)
+{
+	if(!type->dynamicId || type->dynamicId > size_t(_nextid.size()))
+		throw FrontendException("type is not used as dynamic id");
+	_nextid[type->dynamicId - 1] = qMax(_nextid[type->dynamicId - 1], id);
+}
+
 size_t MemoryFrontend::prefixUpper(const QByteArray &prefix)
 {
 	QByteArray tmp = prefix;
@@ -145,30 +789,43 @@ bool MemoryFrontend::contains(const QByteArray &key)
 	return _store.contains(key);
 }
 
+namespace {
+	struct DumpVisitor {
+		QStack<Name> names;
+
+		void down(Name name, size_t n) {
+			names.push(name);
+		}
+
+		void up() {
+			names.pop();
+		}
+
+		void begin(size_t index) {
+			for(size_t i = 0; i < size_t(names.size() + 1); i++)
+				printf("  ");
+			printf("%s[%zu]\n", qPrintable(name2string(names.top())), index);
+		}
+
+		void end() {}
+
+		template<typename T> void var(size_t index, const DeclType *type, const T &value) {
+			for(size_t i = 0; i < size_t(names.size() + 1); i++)
+				printf("  ");
+			const char *quot = type->isString() ? "'" : "";
+			printf("%s[%zu] = %s%s%s\n", qPrintable(name2string(names.top())), index, quot, qPrintable(type->tostring(&value)), quot);
+		}
+	};
+}
+
 void MemoryFrontend::dump() const
 {
-	Value::ConstWalker walker;
-	QStack<Name> names;
-	walker.down = [&](Name name, size_t n) {
-		names.push(name);
-	};
-	walker.up = [&](){ names.pop(); };
-	walker.begin = [&](size_t index, const ValueAccessor *accessor, const void *handle) {
-		for(size_t i = 0; i < size_t(names.size() + 1); i++)
-			printf("  ");
-		printf("%s[%zu]\n", qPrintable(name2string(names.top())), index);
-	};
-	walker.var = [&](size_t index, const DeclType *type, const void *handle) {
-		for(size_t i = 0; i < size_t(names.size() + 1); i++)
-			printf("  ");
-		const char *quot = type->isString() ? "'" : "";
-		printf("%s[%zu] = %s%s%s\n", qPrintable(name2string(names.top())), index, quot, qPrintable(type->tostring(handle)), quot);
-	};
+	DumpVisitor visitor;
 	printf("MemoryFrontend dump\n");
 	printf("  store: %zu\n", _store.size());
 	for(auto it = _store.all(); !it.atEnd(); it.next()) {
 		qHexdump(it.cell<0>(), "    ");
-		it.cell<1>()->constWalk(walker);
+		walk(*it.cell<1>(), visitor);
 		printf("\n");
 	}
 	printf("  dynamic ids: %d\n", _nextid.size());
@@ -181,6 +838,23 @@ void MemoryFrontend::foreachKV(const std::function<void(const QByteArray &key, c
 	for(auto it = _store.all(); !it.atEnd(); it.next())
 		fn(it.cell<0>(), it.cell<1>());
 }
+
+bool MemoryFrontend::fingerprint(size_t l, size_t u, quint64 *hash)
+{
+	rehash();
+	*hash = _store.hashRange(l, qMin(u, _store.size()));
+	return true;
+}
+
+void MemoryFrontend::rehash()
+{
+	for(auto key : _stale) {
+		auto it = _store.single(key);
+		if(!it.atEnd())
+			_store.setHashAt(it.index(), entryHash(key, it.cell<1>()));
+	}
+	_stale.clear();
+}
 #if 0
 bool SyncFrontend::put(const QByteArray &key, const Value &value)
 {
@@ -1,7 +1,18 @@
 #pragma once
 
+#include <QAtomicInt>
 #include <QDir>
-
+#include <QFile>
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QMap>
+#include <QPair>
+#include <QScopedPointer>
+#include <QSet>
+#include <QSharedPointer>
+
+#include "common/PersistentMap.h"
 #include "common/qException.h"
 
 #include "spec.h"
@@ -26,14 +37,72 @@ class Frontend {
 		const spec::DeclMeta *_spec;
 };
 
+//immutable, consistent read view of a SyncFrontend (see SyncFrontend::snapshot()). Copies are O(1) and may be scanned from any thread without locking.
+class FrontendSnapshot {
+	public:
+		typedef PersistentMap<QByteArray, QSharedPointer<const spec::Value>> Map;
+		struct Lease {}; //shared by all copies of the snapshots of a frontend; it publishes changes as long as one is alive
+
+		FrontendSnapshot() : _spec(nullptr) {}
+		FrontendSnapshot(const spec::DeclMeta *spec, const Map &map, const QSharedPointer<Lease> &lease) : _spec(spec), _map(map), _lease(lease) {}
+
+		const spec::DeclMeta *spec() const {
+			return _spec;
+		}
+
+		size_t size() const;
+		QByteArray key(size_t pos) const;
+		const spec::Value *value(size_t pos) const;
+		const spec::Value *get(const QByteArray &key) const; //nullptr, if key does not exist
+		bool contains(const QByteArray &key) const;
+		size_t lower(const QByteArray &prefix) const;
+		size_t upper(const QByteArray &key) const;
+		size_t prefixUpper(const QByteArray &prefix) const;
+		void foreachKV(const std::function<void(const QByteArray &key, const spec::Value *value)> &fn) const;
+
+	private:
+		const spec::DeclMeta *_spec;
+		Map _map;
+		QSharedPointer<Lease> _lease;
+};
+
 class SyncFrontend : public Frontend {
 	public:
+		struct GcStats {
+			size_t values = 0; //number of removed values
+			size_t bytes = 0; //serialized size of removed keys and values
+		};
+
+		//calls beginScan() on construction and endScan() on destruction
+		class ScanGuard {
+			public:
+				ScanGuard(SyncFrontend *fe) : _fe(fe) {
+					fe->beginScan();
+				}
+				~ScanGuard() {
+					_fe->endScan();
+				}
+
+			private:
+				SyncFrontend *_fe;
+		};
+
 		virtual spec::Value *get(const QByteArray &key, bool create = false) = 0;
 		virtual void modified(const QByteArray &key);
+		//store 'value' at 'key' and take ownership of it; an existing value is replaced. the value type has to match the key.
+		//same as filling get(key, true) and calling modified(key), but without copying values built outside of the frontend, e.g. by importers.
+		virtual void insert(const QByteArray &key, spec::Value *value);
+		virtual void pin(const QByteArray &key); //keep data belonging to 'key' resident, until unpin() is called
+		virtual void unpin(const QByteArray &key);
+		//full scans: between these calls, lazy frontends keep all data resident and evict nothing. calls nest; see ScanGuard
+		virtual void beginScan();
+		virtual void endScan();
 		virtual void erase(const QByteArray &key) = 0;
 		virtual void move(const QByteArray &oldkey, const QByteArray &newkey) = 0;
 		virtual void prefixErase(const QByteArray &prefix) = 0;
 		virtual quint64 acquire(const spec::DeclType *type) = 0;
+		virtual quint64 lastId(const spec::DeclType *type) const; //last id handed out by acquire(); 0: none or unknown
+		virtual void reserveId(const spec::DeclType *type, quint64 id); //acquire() will not hand out ids <= 'id' anymore
 		virtual size_t size() const = 0;
 		virtual QByteArray key(size_t pos) = 0;
 		virtual spec::Value *value(size_t pos) = 0;
@@ -46,13 +115,37 @@ class SyncFrontend : public Frontend {
 		virtual bool contains(const QByteArray &key) = 0;
 		virtual void foreachKV(const std::function<void(const QByteArray &key, const spec::Value *value)> &fn) = 0;
 		virtual void dump() const = 0;
-
-		void gc();
-
+		//combined content hash of keys and values in positions [l, u); returns false, if the frontend does not maintain hashes
+		virtual bool fingerprint(size_t l, size_t u, quint64 *hash);
+
+		//removes all rows referencing a dynamic id, which is not owned by any value anymore (see DeclDynid)
+		GcStats gc();
+		//prefixes of the rows referencing a dynamic id owned by 'value' at 'key', e.g. all properties of an object
+		QList<QByteArray> ownedPrefixes(const QByteArray &key, const spec::Value *value) const;
+		//copy all differences from 'source' into 'target' in one transaction; only changed rows and the keys owning them are written.
+		//used to export to and import from the directory layout, e.g. mirror(logFrontend, dirFrontend).
+		static void mirror(SyncFrontend *source, SyncFrontend *target);
+
+		//transactions: changes are applied in memory immediately; commit() persists all keys touched since begin() in one flush, rollback() restores their state at begin().
+		//values handed out by get()/value() are journaled on first access, so in-place changes are covered as well.
+		//transactions nest: only the outermost commit() flushes, rollback() aborts the outermost transaction.
+		void begin();
+		void commit();
+		void rollback();
+		bool inTransaction() const;
+
+		//read view of the current state, e.g. for searches, exports or indexing in worker threads.
+		//the first call copies all values once; from then on every change pays an O(log n) path copy plus a copy of the changed value, and snapshot() itself is O(1).
+		//once the last snapshot is released, the next change drops the copy and stops publishing, so the next snapshot() is O(n) again.
+		FrontendSnapshot snapshot();
+
+		//reports every key which is only present in 'a' (b side empty), only present in 'b' (a side empty) or whose values differ.
+		//ranges with equal fingerprints on both sides are skipped without visiting their values.
 		static void diff(SyncFrontend *a, SyncFrontend *b, const std::function<void(const QByteArray&, spec::Value*, const QByteArray&, spec::Value*)> &cb);
 
 		template<typename T> T *value(size_t pos) {
-			T *result = dynamic_cast<T*>(value(pos));
+			spec::Value *v = value(pos);
+			T *result = v ? v->to<T>() : nullptr;
 			if(!result)
 				throw FrontendException("invalid value type requested");
 			return result;
@@ -63,7 +156,7 @@ class SyncFrontend : public Frontend {
 			if(!v) {
 				return nullptr;
 			}
-			T *result = dynamic_cast<T*>(v);
+			T *result = v->to<T>();
 			if(!result)
 				throw FrontendException("invalid value type requested");
 			return result;
@@ -74,7 +167,7 @@ class SyncFrontend : public Frontend {
 			if(!v) {
 				return nullptr;
 			}
-			return dynamic_cast<T*>(v);
+			return v->to<T>();
 		}
 
 		void range(size_t *l, size_t *u, const QByteArray &key) {
@@ -93,12 +186,135 @@ class SyncFrontend : public Frontend {
 			return u - l;
 		}
 
+		//fingerprint of everything below 'prefix', e.g. a whole object, letter or book
+		bool prefixFingerprint(const QByteArray &prefix, quint64 *hash) {
+			size_t l = lower(prefix);
+			size_t u = prefixUpper(prefix);
+			return fingerprint(l, u, hash);
+		}
+
+		//key codec API: keys are encoded into a stack buffer and passed on without copying
+		template<typename K> spec::Value *get(const spec::KeyCodec<K> &key, bool create = false) {
+			char data[spec::KeyCodec<K>::Size];
+			key.encode(data);
+			if(create) //a created value keeps its key
+				return get(QByteArray(data, sizeof(data)), true);
+			return get(QByteArray::fromRawData(data, sizeof(data)));
+		}
+
+		template<typename T, typename K> T *get(const spec::KeyCodec<K> &key, bool create = false) {
+			spec::Value *v = get(key, create);
+			if(!v) {
+				return nullptr;
+			}
+			T *result = v->to<T>();
+			if(!result)
+				throw FrontendException("invalid value type requested");
+			return result;
+		}
+
+		template<typename K> bool contains(const spec::KeyCodec<K> &key) {
+			char data[spec::KeyCodec<K>::Size];
+			key.encode(data);
+			return contains(QByteArray::fromRawData(data, sizeof(data)));
+		}
+
+		template<typename K> void modified(const spec::KeyCodec<K> &key) {
+			char data[spec::KeyCodec<K>::Size];
+			key.encode(data);
+			modified(QByteArray::fromRawData(data, sizeof(data)));
+		}
+
+		//range of all keys starting with the fields of 'key' up to (including) 'last'
+		template<typename K> void prefixRange(size_t *l, size_t *u, const spec::KeyCodec<K> &key, K last) {
+			char data[spec::KeyCodec<K>::Size];
+			key.encode(data);
+			QByteArray prefix = QByteArray::fromRawData(data, spec::KeyCodec<K>::Offsets[spec::KeyInfo<K>::toInt(last) + 1]);
+			*l = lower(prefix);
+			*u = prefixUpper(prefix);
+		}
+
 	protected:
+		struct TxEntry {
+			bool existed; //false: key has been created during the transaction
+			bool modified; //modified() has been called for the key
+			QByteArray data; //serialized value at begin()
+		};
+
 		SyncFrontend(const spec::DeclMeta *spec);
+
+		static quint64 entryHash(const QByteArray &key, const spec::Value *value); //row hash used for fingerprints
+
+		void journal(const QByteArray &key, const spec::Value *value); //record state of 'key' (value: nullptr if absent) before it is changed; no-op outside of transactions
+		void journalModified(const QByteArray &key, const spec::Value *value); //like journal(), and flush 'key' at commit even if its own value is unchanged
+		bool changedSince(const QByteArray &key, const TxEntry &entry, spec::Value *value) const; //value: current value of 'key' or nullptr
+		spec::Value *decode(const QByteArray &key, const TxEntry &entry) const; //new value holding the state at begin(); caller has to destroy it
+		virtual void txFlush(const QList<QByteArray> &keys, const QHash<QByteArray, TxEntry> &before); //persist touched 'keys' (in order of first access)
+		void publish(const QByteArray &key, const spec::Value *value); //make current state of 'key' visible to future snapshots; value: nullptr if 'key' has been removed
+
+	private:
+		int _txDepth;
+		bool _txRestoring;
+		QList<QByteArray> _txKeys;
+		QHash<QByteArray, TxEntry> _txBefore;
+		bool _snapshots; //true: '_published' is maintained
+		FrontendSnapshot::Map _published;
+		QWeakPointer<FrontendSnapshot::Lease> _lease; //expires with the last live snapshot
 };
 
+namespace detail {
+	template<typename T> struct FutureDelivery {
+		template<typename F> static void deliver(const QFuture<T> &future, F &fn) {
+			fn(future.result());
+		}
+	};
+
+	template<> struct FutureDelivery<void> {
+		template<typename F> static void deliver(const QFuture<void> &future, F &fn) {
+			fn();
+		}
+	};
+}
+
+//runs all operations of a SyncFrontend on a dedicated I/O thread. Returned values are detached copies, so they may be used from any thread.
+//The wrapped frontend must not be accessed directly while the AsyncFrontend exists.
+//Failed operations (i.e. the job threw an Exception) result in a canceled future.
 class AsyncFrontend : public Frontend {
+	public:
+		typedef QSharedPointer<spec::Value> ValuePtr;
+		typedef QPair<QByteArray, ValuePtr> Entry;
+
+		AsyncFrontend(SyncFrontend *backend);
+		virtual ~AsyncFrontend(); //finishes all pending jobs
+
+		virtual QFuture<ValuePtr> get(const QByteArray &key); //null, if key does not exist
+		virtual QFuture<QList<Entry>> prefixScan(const QByteArray &prefix); //all entries below 'prefix' in key order
+		virtual QFuture<void> put(const QByteArray &key, const spec::Value &value); //create or overwrite value at 'key'; type must match the key
+		virtual QFuture<void> erase(const QByteArray &key);
+		virtual QFuture<void> prefixErase(const QByteArray &prefix);
+		QFuture<void> run(const std::function<void(SyncFrontend *backend)> &job); //run arbitrary job on the I/O thread
+
+		//continuation: call 'fn' in the thread of 'context' once 'future' has finished. 'fn' is not called, if the future has been canceled or 'context' has been destroyed before.
+		template<typename T, typename F> static void then(const QFuture<T> &future, QObject *context, F fn) {
+			QFutureWatcher<T> *watcher = new QFutureWatcher<T>(context);
+			QObject::connect(watcher, &QFutureWatcherBase::finished, context, [watcher, fn]() mutable {
+				if(!watcher->isCanceled())
+					detail::FutureDelivery<T>::deliver(watcher->future(), fn);
+				watcher->deleteLater();
+			});
+			watcher->setFuture(future);
+		}
+
+		static ValuePtr clone(const spec::Value *value); //detached copy of 'value'; null if 'value' is null
+
+	protected:
+		template<typename T> QFuture<T> post(const std::function<T(SyncFrontend *backend)> &job);
 
+	private:
+		class Worker;
+
+		SyncFrontend *_backend;
+		Worker *_worker;
 };
 
 class MemoryFrontend : public SyncFrontend {
@@ -107,10 +323,14 @@ class MemoryFrontend : public SyncFrontend {
 		virtual ~MemoryFrontend();
 
 		virtual spec::Value *get(const QByteArray &key, bool create = false) override;
+		virtual void modified(const QByteArray &key) override;
+		virtual void insert(const QByteArray &key, spec::Value *value) override;
 		virtual void erase(const QByteArray &key) override;
 		virtual void move(const QByteArray &oldkey, const QByteArray &newkey) override;
 		virtual void prefixErase(const QByteArray &prefix) override;
 		virtual quint64 acquire(const spec::DeclType *type) override;
+		virtual quint64 lastId(const spec::DeclType *type) const override;
+		virtual void reserveId(const spec::DeclType *type, quint64 id) override;
 		virtual size_t size() const override;
 		virtual QByteArray key(size_t pos) override;
 		virtual spec::Value *value(size_t pos) override;
@@ -119,11 +339,15 @@ class MemoryFrontend : public SyncFrontend {
 		virtual size_t prefixUpper(const QByteArray &prefix) override;
 		virtual bool contains(const QByteArray &key) override;
 		virtual void foreachKV(const std::function<void(const QByteArray &key, const spec::Value *value)> &fn) override;
+		virtual bool fingerprint(size_t l, size_t u, quint64 *hash) override;
 
 		virtual void dump() const override;
 
 	private:
+		void rehash();
+
 		AvlTable<1, QByteArray, spec::Value*> _store;
+		QSet<QByteArray> _stale; //keys whose row hash has to be recomputed
 		QVector<quint64> _nextid;
 };
 
@@ -137,16 +361,37 @@ class AbstractDirFrontend : public SyncFrontend {
 		QDir rootdir() const;
 		void suspend();
 		void resume();
+		void setLazy(bool lazy); //must be called before load(); lazy frontends load parts of the data on first access
+		bool isLazy() const;
+		void setMemoryBudget(size_t bytes); //lazy mode only: unpinned, clean groups are evicted least recently used first, once resident groups exceed 'bytes'; 0: unlimited
+		size_t memoryBudget() const;
+		//journaled frontends make each commit durable with a single append to a write-ahead journal and write the object files later from the event loop.
+		//changes outside of transactions are committed one by one. a journal left over by a crash is replayed by load() in any case.
+		void setJournaled(bool journaled); //must be called before load()
+		bool isJournaled() const;
+		void flush(); //write all journaled changes into the object files and clear the journal; call before destroying the frontend
+		//between these calls, values created by get(key, true) or put() are collected instead of inserted one by one; endBulkLoad() sorts them and rebuilds the store in one pass.
+		//collected values are not visible to lookups before endBulkLoad(); repeated keys resolve last-writer-wins. load() wraps actionLoad() this way.
+		void beginBulkLoad();
+		void endBulkLoad();
 
 		static QString decodeFilename(const QString &filename);
+		static QStringList decodeFilenames(const QStringList &filenames);
 		static QString encodeFilename(const QString &name);
 
 		virtual spec::Value *get(const QByteArray &key, bool create = false) override;
 		virtual void modified(const QByteArray &key) override;
+		virtual void insert(const QByteArray &key, spec::Value *value) override;
+		virtual void pin(const QByteArray &key) override;
+		virtual void unpin(const QByteArray &key) override;
+		virtual void beginScan() override;
+		virtual void endScan() override;
 		virtual void erase(const QByteArray &key) override;
 		virtual void move(const QByteArray &oldkey, const QByteArray &newkey) override;
 		virtual void prefixErase(const QByteArray &prefix) override;
 		virtual quint64 acquire(const spec::DeclType *type) override;
+		virtual quint64 lastId(const spec::DeclType *type) const override;
+		virtual void reserveId(const spec::DeclType *type, quint64 id) override;
 		virtual size_t size() const override;
 		virtual QByteArray key(size_t pos) override;
 		virtual spec::Value *value(size_t pos) override;
@@ -155,6 +400,7 @@ class AbstractDirFrontend : public SyncFrontend {
 		virtual size_t prefixUpper(const QByteArray &prefix) override;
 		virtual bool contains(const QByteArray &key) override;
 		virtual void foreachKV(const std::function<void(const QByteArray &key, const spec::Value *value)> &fn) override;
+		virtual bool fingerprint(size_t l, size_t u, quint64 *hash) override;
 
 		virtual void dump() const override;
 
@@ -164,24 +410,161 @@ class AbstractDirFrontend : public SyncFrontend {
 		virtual void actionSave() = 0;
 		virtual void actionErase(const QByteArray &key, spec::Value *value) = 0;
 		virtual void actionModify(const QByteArray &key, spec::Value *value) = 0;
+		virtual void actionFault(const QByteArray &prefix); //called before 'prefix' is accessed; lazy frontends materialize the affected values here
+		virtual quint64 actionGroup(const QByteArray &key); //return the evictable group 'key' belongs to; 0: none
+		virtual void actionEvict(quint64 group); //drop all values of 'group' using unload(); they have to be materialized again by actionFault()
+
+		virtual void txFlush(const QList<QByteArray> &keys, const QHash<QByteArray, TxEntry> &before) override;
 
 		void put(const QByteArray &key, spec::Value *value);
+		quint64 acquire(const spec::DeclType *type, const QString &path); //like acquire(type), but reuses the id persisted for 'path' (relative to rootdir()) in an earlier session
+		void bindId(const QString &path, quint64 id); //persist 'id' for 'path'
+		void unbindId(const QString &path, bool children = false); //children: also unbind all paths below 'path'
+		spec::Value *peek(const QByteArray &key) const; //lookup without faulting
+		static bool syncFile(QFile &file); //flush 'file' and write it through to disk
+		void unload(const QByteArray &prefix); //remove values without calling any action
+		void groupLoaded(quint64 group, size_t bytes);
+		void groupClean(quint64 group);
+		void groupRemoved(quint64 group);
 
 	private:
+		struct Group {
+			size_t bytes = 0;
+			quint64 tick = 0;
+			bool dirty = false;
+		};
+
+		bool deferred() const; //true: actions are postponed until resume() or commit()
+		bool implicitTransaction(const std::function<void()> &fn); //journaled mode: run 'fn' in its own transaction, unless one is open; returns false, if 'fn' has not been run
+		void materialize(const QList<QByteArray> &keys, const QHash<QByteArray, TxEntry> &before);
+		void journalBatch(const QList<QByteArray> &keys, const QHash<QByteArray, TxEntry> &before);
+		void replayJournal();
+		bool replayBatch(const QByteArray &body); //false: malformed, nothing applied
+		void addPending(const QByteArray &key, const TxEntry &entry);
+		void scheduleFlush();
+		void dropFlusher(); //cancel a scheduled flush and release its context
+		void fault(const QByteArray &prefix);
+		void touch(quint64 group);
+		void groupDirty(quint64 group);
+		void evict(quint64 keep = 0);
+		size_t storeUpper(const QByteArray &prefix) const;
+		void loadIds();
+		void pruneIds();
+		void untakeId(quint64 id, const QString &path); //release 'id', if 'path' holds it
+		void saveIds();
+		void rehash();
+
 		bool _suspended;
+		bool _lazy;
+		bool _faulting;
+		size_t _budget;
+		size_t _resident;
+		int _scans; //nesting depth of beginScan(); nothing is evicted while > 0
+		quint64 _tick;
+		QHash<quint64, Group> _groups;
+		QHash<quint64, int> _pins;
+		QMap<quint64, quint64> _lru; //[tick] -> group
+		QMap<QString, quint64> _ids; //[path] -> persistent id
+		QHash<quint64, QString> _idsTaken; //[id] -> path, which took it in this session
+		bool _idsDirty;
+		bool _journaled;
+		bool _flushScheduled;
+		QFile _journal;
+		QList<QByteArray> _pendingKeys; //journaled, but not yet written to the object files
+		QHash<QByteArray, TxEntry> _pendingBefore;
+		QScopedPointer<QObject> _flusher; //context of the scheduled flush; lives in the thread that scheduled it
+		QSharedPointer<QAtomicInt> _flushCancelled; //set, when _flusher is dropped; read by its timer in the flusher's thread
 		QDir _rootdir;
 		AvlTable<1, QByteArray, spec::Value*> _store;
+		bool _bulkLoading;
+		std::vector<AvlTable<1, QByteArray, spec::Value*>::RowTuple> _bulk; //values collected between beginBulkLoad() and endBulkLoad()
+		QSet<QByteArray> _stale; //keys whose row hash has to be recomputed
 		QVector<quint64> _nextid;
 };
 
-class CacheFrontend : public SyncFrontend {
+//stores all rows in a single append-only log file instead of one file per object. The log is mapped into memory on load and a sorted index
+//locates the newest record of each key; in lazy mode, values are decoded from the mapping on first access. Once more than half of the file
+//consists of overwritten or erased records, the log is compacted by rewriting all live rows. Records carry a checksum and every action is synced
+//to disk; a torn or corrupt tail left by a crash is cut off by the next load().
+//use SyncFrontend::mirror() to export to or import from the Git friendly directory layout.
+class LogFrontend : public AbstractDirFrontend {
+	public:
+		LogFrontend(const spec::DeclMeta *spec, const QDir &dir);
+		virtual ~LogFrontend();
+
+		void compact();
+		quint64 garbage() const; //bytes occupied by overwritten or erased records
+
+	protected:
+		virtual void actionLoad() override;
+		virtual void actionSave() override;
+		virtual void actionErase(const QByteArray &key, spec::Value *value) override;
+		virtual void actionModify(const QByteArray &key, spec::Value *value) override;
+		virtual void actionFault(const QByteArray &prefix) override;
+
+	private:
+		struct Extent {
+			quint64 offset; //position of the record within the log
+			quint32 size; //record size including length prefix
+			quint64 hash; //content hash of the value written; valid if 'loaded'
+			bool loaded; //value is resident; unloaded values are decoded from the mapping
+		};
+
+		void open();
+		void close();
+		void append(const QByteArray &record);
+		void sync(); //one fsync per action, not per record
+		void write(const QByteArray &key, spec::Value *value); //append put record, unless the value has not changed
+		spec::Value *decode(const Extent &extent) const;
+		void compactIfWasteful();
+
+		QFile _file;
+		uchar *_map;
+		qint64 _mapSize;
+		QMap<QByteArray, Extent> _index;
+		quint64 _garbage;
+};
+
+//in-memory store of detached values. Remembers the prefixes, which have been loaded completely, so absent keys below them are known to be absent.
+//'capacity' limits the number of complete prefixes kept; the least recently used one is dropped first. 0 means unlimited.
+class CacheFrontend : public MemoryFrontend {
+	public:
+		CacheFrontend(const spec::DeclMeta *spec, size_t capacity = 0);
+
+		bool covers(const QByteArray &prefix); //true, if everything below 'prefix' is cached. marks 'prefix' as recently used.
+		void fill(const QByteArray &prefix, const QList<AsyncFrontend::Entry> &entries); //replace everything below 'prefix' by 'entries'
+		void store(const QByteArray &key, const spec::Value *value); //copy 'value' into the cache
+		void drop(const QByteArray &prefix); //forget everything below 'prefix'
+		void reset();
 
+	private:
+		size_t _capacity;
+		quint64 _tick;
+		QHash<QByteArray, quint64> _complete; //prefix -> last use
 };
 
+//AsyncFrontend, which serves hot keys synchronously from a CacheFrontend.
+//A miss loads the whole group of the requested key (key fields plus first data field, e.g. all comments of a letter), so neighbouring keys are prefetched.
+//Writes go to the cache immediately and are forwarded to the backend.
 class CachingFrontend : public AsyncFrontend {
 	public:
-		CachingFrontend(CacheFrontend *cache);
+		CachingFrontend(SyncFrontend *backend, CacheFrontend *cache);
+
+		spec::Value *cached(const QByteArray &key, bool *known = nullptr); //synchronous lookup; 'known' is set to false, if the cache cannot answer and get() is required
+		QByteArray groupPrefix(const QByteArray &key) const;
+
+		virtual QFuture<ValuePtr> get(const QByteArray &key) override;
+		virtual QFuture<QList<Entry>> prefixScan(const QByteArray &prefix) override;
+		virtual QFuture<void> put(const QByteArray &key, const spec::Value &value) override;
+		virtual QFuture<void> erase(const QByteArray &key) override;
+		virtual QFuture<void> prefixErase(const QByteArray &prefix) override;
+
+	private:
+		QFuture<QList<Entry>> fetch(const QByteArray &group);
 
+		CacheFrontend *_cache;
+		QObject _context; //continuations updating the cache run in the thread owning the CachingFrontend
+		QHash<QByteArray, QFuture<QList<Entry>>> _pending; //group prefix -> running fetch
 };
 
 #if 0
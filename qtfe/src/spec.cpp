@@ -1,4 +1,5 @@
 #include <QtEndian>
+#include <string.h>
 
 #include "common/qHexdump.h"
 
@@ -146,6 +147,105 @@ namespace spec {
 		return !eqRecursive(decl(), decl()->accessor, this, &other, decl()->vars, nvar);
 	}
 
+	void BinaryWriter::put(const DeclKey *v)
+	{
+		put(quint16(v ? v->ordinal + 1 : 0));
+	}
+
+	void BinaryWriter::put(const DeclType *v)
+	{
+		put(quint16(v ? v->ordinal + 1 : 0));
+	}
+
+	void ValueHasher::put(const DeclKey *v)
+	{
+		mix(v ? v->ordinal + 1 : 0);
+	}
+
+	void ValueHasher::put(const DeclType *v)
+	{
+		mix(v ? v->ordinal + 1 : 0);
+	}
+
+	bool BinaryReader::get(const DeclKey *&v)
+	{
+		quint16 ord;
+		if(!get(ord) || ord > _meta->nKeys)
+			return false;
+		v = ord ? _meta->keys[ord - 1] : nullptr;
+		return true;
+	}
+
+	bool BinaryReader::get(const DeclType *&v)
+	{
+		quint16 ord;
+		if(!get(ord) || ord > _meta->nTypes)
+			return false;
+		v = ord ? _meta->types[ord - 1] : nullptr;
+		return true;
+	}
+
+	namespace {
+		const size_t binaryHeaderSize = 10;
+
+		quint32 specTag(const DeclMeta *meta)
+		{
+			return nameHash(0, meta->name, strlen(meta->name));
+		}
+	}
+
+	QByteArray Value::toBinary() const
+	{
+		size_t payload = serialSize();
+		QByteArray result;
+		result.reserve(binaryHeaderSize + payload);
+		BinaryWriter writer(&result);
+		writer.put(specTag(decl()->meta));
+		writer.put(quint16(decl()->ordinal));
+		writer.put(quint32(payload));
+		serialize(writer);
+		Q_ASSERT(size_t(result.size()) == binaryHeaderSize + payload);
+		return result;
+	}
+
+	Value *Value::fromBinary(const DeclMeta *meta, const char *data, size_t size, size_t *consumed)
+	{
+		BinaryReader header(meta, data, size);
+		quint32 tag;
+		quint16 ordinal;
+		quint32 payload;
+		if(!header.get(tag) || !header.get(ordinal) || !header.get(payload))
+			return nullptr;
+		if(tag != specTag(meta) || ordinal >= meta->nValues || payload > header.remaining())
+			return nullptr;
+
+		const DeclValue *decl = meta->values[ordinal];
+		Value *value = static_cast<Value*>(decl->create());
+		BinaryReader reader(meta, data + binaryHeaderSize, payload);
+		if(!value->deserialize(reader) || !reader.atEnd()) {
+			decl->destroy(value);
+			return nullptr;
+		}
+		if(consumed)
+			*consumed = binaryHeaderSize + payload;
+		return value;
+	}
+
+	Value *Value::clone() const
+	{
+		QByteArray data;
+		data.reserve(serialSize());
+		BinaryWriter writer(&data);
+		serialize(writer);
+		Value *value = static_cast<Value*>(decl()->create());
+		BinaryReader reader(decl()->meta, data.constData(), data.size());
+		if(!value->deserialize(reader)) {
+			decl()->destroy(value);
+			throw SpecException("cannot clone value: malformed serialization");
+		}
+		return value;
+	}
+
 	const DeclMeta *DeclMeta::version(const QString &version)
 	{
 		if(version == "1.0")
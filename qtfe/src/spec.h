@@ -4,6 +4,7 @@
 #include <QMap>
 #include <QString>
 #include <QStack>
+#include <QtEndian>
 
 #include <stdio.h>
 
@@ -30,15 +31,35 @@ namespace spec {
 	class ValueAccessor;
 	template<typename T> struct EnumInfo;
 
+	//seeded FNV-1a; specgen and globalgen use the same function to build the perfect hash tables of names
+	static constexpr quint32 nameHash(quint32 seed, const char *data, size_t len) {
+		quint32 hash = 2166136261u ^ seed;
+		for(size_t i = 0; i < len; i++) {
+			hash ^= quint8(data[i]);
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
 	enum class Name; //defined in generated spec-global.h
 	extern const QString names[];
+	extern const quint16 nameHashTable[]; //[hash slot] -> name index; 0: empty
 #include "../spec/spec-global.h"
 
 	static inline Name string2name(const QString &str) {
-		for(size_t i = 1; i < nNames; i++)
-			if(str == names[i])
-				return static_cast<Name>(i);
-		return Name::null;
+		char ascii[nameMaxLength + 1]; //names are ascii only
+		if(size_t(str.size()) > nameMaxLength)
+			return Name::null;
+		for(int i = 0; i < str.size(); i++) {
+			ushort c = str.at(i).unicode();
+			if(c >= 0x80)
+				return Name::null;
+			ascii[i] = c;
+		}
+		size_t index = nameHashTable[nameHash(nameHashSeed, ascii, str.size()) & (nameHashSize - 1)];
+		if(!index || names[index] != str)
+			return Name::null;
+		return static_cast<Name>(index);
 	}
 
 	static inline QString name2string(Name name) {
@@ -68,6 +89,7 @@ namespace spec {
 
 	struct DeclType;
 	struct DeclKey;
+	struct DeclMeta;
 	struct DeclValue;
 	struct DeclVar;
 	struct DeclField;
@@ -80,6 +102,11 @@ namespace spec {
 
 	};
 
+	struct DeclDynidRef {
+		const DeclKey *key;
+		size_t field; //key field containing the referenced id
+	};
+
 	struct DeclDynid {
 		enum Type {
 			NullType, FieldType, VarType
@@ -92,8 +119,11 @@ namespace spec {
 			struct {
 				const DeclValue *decl;
 				const size_t *varpath;
+				size_t nVarpath;
 			} value;
 		} u;
+		const DeclDynidRef *refs; //keys, whose rows are orphans once the id is no longer owned
+		size_t nRefs;
 	};
 
 	struct DeclType {
@@ -113,6 +143,9 @@ namespace spec {
 		const DeclDynid *owners = nullptr;
 		size_t nOwners = 0;
 
+		size_t ordinal = 0; //index of type within its spec
+		size_t enumOrdinal = 0; //index of first enum value within all enum values of its spec
+
 		bool is(const DeclType *type) const {
 			const DeclType *cur = this;
 			while(cur) {
@@ -279,6 +312,7 @@ namespace spec {
 		const DeclKey **subKeys;
 		size_t nSubKeys;
 		const DeclValue *mapto = nullptr;
+		size_t ordinal = 0; //index of key within its spec
 
 		const DeclField *findField(const QString &name) const {
 			for(size_t i = 0; i < nFields; i++)
@@ -315,6 +349,8 @@ namespace spec {
 
 	struct DeclValue {
 		Name name;
+		size_t ordinal; //index of value within its spec
+		const DeclMeta *meta;
 		size_t size; //minimum number of rows
 		bool flexible; //last row declaration has n == 0
 		const DeclVar *vars;
@@ -369,6 +405,146 @@ namespace spec {
 		static const DeclMeta *version(const QString &version);
 	};
 
+	//binary value encoding: little-endian; strings and flexible lists carry a u32 length prefix
+	struct BinaryWriter {
+		BinaryWriter(QByteArray *out) : _out(out) {}
+
+		void put(bool v) { put(quint8(v)); }
+		void put(quint8 v) { _out->append(char(v)); }
+		void put(quint16 v) { qToLittleEndian<quint16>(v, reinterpret_cast<uchar*>(grow(2))); }
+		void put(quint32 v) { qToLittleEndian<quint32>(v, reinterpret_cast<uchar*>(grow(4))); }
+		void put(quint64 v) { qToLittleEndian<quint64>(v, reinterpret_cast<uchar*>(grow(8))); }
+		void put(const QString &v) {
+			put(quint32(v.size()));
+			const ushort *src = v.utf16();
+			uchar *dst = reinterpret_cast<uchar*>(grow(2 * v.size()));
+			for(int i = 0; i < v.size(); i++)
+				qToLittleEndian<quint16>(src[i], dst + 2 * i);
+		}
+		void put(const QByteArray &v) {
+			put(quint32(v.size()));
+			_out->append(v);
+		}
+		void put(const DeclKey *v); //ordinal + 1; 0: nullptr
+		void put(const DeclType *v);
+
+		static constexpr size_t sizeOf(bool) { return 1; }
+		static constexpr size_t sizeOf(quint8) { return 1; }
+		static constexpr size_t sizeOf(quint16) { return 2; }
+		static constexpr size_t sizeOf(quint32) { return 4; }
+		static constexpr size_t sizeOf(quint64) { return 8; }
+		static size_t sizeOf(const QString &v) { return 4 + 2 * v.size(); }
+		static constexpr size_t sizeOf(const DeclKey*) { return 2; }
+		static constexpr size_t sizeOf(const DeclType*) { return 2; }
+
+	private:
+		char *grow(int n) {
+			int size = _out->size();
+			_out->resize(size + n);
+			return _out->data() + size;
+		}
+
+		QByteArray *_out;
+	};
+
+	//64 bit content hash; accepts the same put() calls as BinaryWriter, so it hashes exactly the serialized form
+	struct ValueHasher {
+		ValueHasher(quint64 seed = 0) : _h(seed ^ 0x9e3779b97f4a7c15ull) {}
+
+		void put(bool v) { mix(v); }
+		void put(quint8 v) { mix(v); }
+		void put(quint16 v) { mix(v); }
+		void put(quint32 v) { mix(v); }
+		void put(quint64 v) { mix(v); }
+		void put(const QString &v) {
+			const ushort *src = v.utf16();
+			int n = v.size();
+			int i = 0;
+			mix(n);
+			for(; i + 4 <= n; i += 4)
+				mix(quint64(src[i]) | quint64(src[i + 1]) << 16 | quint64(src[i + 2]) << 32 | quint64(src[i + 3]) << 48);
+			for(; i < n; i++)
+				mix(src[i]);
+		}
+		void put(const QByteArray &v) {
+			const uchar *src = reinterpret_cast<const uchar*>(v.constData());
+			int n = v.size();
+			int i = 0;
+			mix(n);
+			for(; i + 8 <= n; i += 8)
+				mix(qFromLittleEndian<quint64>(src + i));
+			for(; i < n; i++)
+				mix(src[i]);
+		}
+		void put(const DeclKey *v);
+		void put(const DeclType *v);
+
+		quint64 result() const { //murmur3 finalizer
+			quint64 h = _h;
+			h ^= h >> 33;
+			h *= 0xff51afd7ed558ccdull;
+			h ^= h >> 33;
+			h *= 0xc4ceb9fe1a85ec53ull;
+			h ^= h >> 33;
+			return h;
+		}
+
+	private:
+		void mix(quint64 v) {
+			_h = (_h ^ v) * 0x100000001b3ull;
+			_h ^= _h >> 29;
+		}
+
+		quint64 _h;
+	};
+
+	struct BinaryReader {
+		BinaryReader(const DeclMeta *meta, const char *data, size_t size) : _meta(meta), _cur(data), _end(data + size) {}
+
+		bool get(bool &v) { quint8 b; if(!get(b) || b > 1) return false; v = b; return true; }
+		bool get(quint8 &v) { if(!take(1)) return false; v = quint8(_cur[-1]); return true; }
+		bool get(quint16 &v) { if(!take(2)) return false; v = qFromLittleEndian<quint16>(reinterpret_cast<const uchar*>(_cur - 2)); return true; }
+		bool get(quint32 &v) { if(!take(4)) return false; v = qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(_cur - 4)); return true; }
+		bool get(quint64 &v) { if(!take(8)) return false; v = qFromLittleEndian<quint64>(reinterpret_cast<const uchar*>(_cur - 8)); return true; }
+		bool get(QString &v) {
+			quint32 n;
+			if(!get(n) || n > remaining() / 2)
+				return false;
+			v.resize(n);
+			ushort *dst = reinterpret_cast<ushort*>(v.data());
+			for(quint32 i = 0; i < n; i++)
+				dst[i] = qFromLittleEndian<quint16>(reinterpret_cast<const uchar*>(_cur + 2 * i));
+			_cur += 2 * n;
+			return true;
+		}
+		bool get(QByteArray &v) {
+			quint32 n;
+			if(!get(n) || n > remaining())
+				return false;
+			v = QByteArray(_cur, n);
+			_cur += n;
+			return true;
+		}
+		bool get(const DeclKey *&v);
+		bool get(const DeclType *&v);
+
+		//upper bound for list reservations; every element occupies at least one byte
+		size_t remaining() const { return _end - _cur; }
+		bool atEnd() const { return _cur == _end; }
+
+	private:
+		bool take(size_t n) {
+			if(remaining() < n)
+				return false;
+			_cur += n;
+			return true;
+		}
+
+		const DeclMeta *_meta;
+		const char *_cur;
+		const char *_end;
+	};
+
 
 	struct ValueAccessor {
 		virtual size_t count() const = 0;
@@ -407,18 +583,37 @@ namespace spec {
 		virtual ~Value() {}
 
 		virtual const DeclValue *decl() const = 0;
-//		virtual Value *clone() const = 0;
+		Value *clone() const; //deep copy through the binary serializers; destroy with decl()->destroy()
+		//generated values carry their declaration as type tag; dynamic_cast only verifies in debug builds
 		template<typename T> T *to() {
-			return dynamic_cast<T*>(this);
+			if(decl() != T::DeclObject)
+				return nullptr;
+			Q_ASSERT(dynamic_cast<T*>(this));
+			return static_cast<T*>(this);
 		}
 		template<typename T> const T *to() const {
-			return dynamic_cast<const T*>(this);
+			if(decl() != T::DeclObject)
+				return nullptr;
+			Q_ASSERT(dynamic_cast<const T*>(this));
+			return static_cast<const T*>(this);
 		}
 
 
 		void constWalk(const ConstWalker &walker) const;
 		void walk(const Walker &walker);
 
+		virtual size_t serialSize() const = 0; //exact size of serialize() output
+		virtual void serialize(BinaryWriter &writer) const = 0;
+		virtual bool deserialize(BinaryReader &reader) = 0; //false: truncated or malformed input
+		virtual quint64 contentHash() const = 0; //equal values of equal type have equal hashes
+
+		//framed encoding: u32 spec tag, u16 value ordinal, u32 payload length, payload
+		QByteArray toBinary() const;
+		static Value *fromBinary(const DeclMeta *meta, const char *data, size_t size, size_t *consumed = nullptr);
+		static Value *fromBinary(const DeclMeta *meta, const QByteArray &data) {
+			return fromBinary(meta, data.constData(), data.size());
+		}
+
 		bool operator==(const Value &other) const;
 		bool operator!=(const Value &other) const;
 
@@ -488,15 +683,17 @@ namespace spec {
 	};
 
 
+	//dense: generated direct lookup tables, indexed by DeclType::enumOrdinal + value, DeclType::ordinal or DeclKey::ordinal
 	template<typename STRUCT, size_t SIZE> struct MappingImpl<DeclEnum, STRUCT, SIZE> {
 		static constexpr size_t N = SIZE;
 		static const MappedValue<DeclEnum, STRUCT> mapping[N];
+		static const size_t nDense;
+		static const MappedValue<DeclEnum, STRUCT> *const dense[];
 
 		static const STRUCT &get(const DeclType *type, quint64 value) {
-			for(size_t i = 0; i < N; i++)
-				if(mapping[i].type == type && mapping[i].value == value)
-					return *mapping[i].aux;
-			return STRUCT::Default;
+			size_t ordinal = type->enumOrdinal + value;
+			const MappedValue<DeclEnum, STRUCT> *cur = value < type->nEnumValues && ordinal < nDense ? dense[ordinal] : nullptr;
+			return cur && cur->type == type ? *cur->aux : STRUCT::Default;
 		}
 
 		template<typename ENUM> static const STRUCT &get(ENUM value) {
@@ -507,24 +704,24 @@ namespace spec {
 	template<typename STRUCT, size_t SIZE> struct MappingImpl<DeclType, STRUCT, SIZE> {
 		static constexpr size_t N = SIZE;
 		static const MappedValue<DeclType, STRUCT> mapping[N];
+		static const size_t nDense;
+		static const MappedValue<DeclType, STRUCT> *const dense[];
 
 		static const STRUCT &get(const DeclType *type) {
-			for(size_t i = 0; i < N; i++)
-				if(mapping[i].type == type)
-					return *mapping[i].aux;
-			return STRUCT::Default;
+			const MappedValue<DeclType, STRUCT> *cur = type->ordinal < nDense ? dense[type->ordinal] : nullptr;
+			return cur && cur->type == type ? *cur->aux : STRUCT::Default;
 		}
 	};
 
 	template<typename STRUCT, size_t SIZE> struct MappingImpl<DeclKey, STRUCT, SIZE> {
 		static constexpr size_t N = SIZE;
 		static const MappedValue<DeclKey, STRUCT> mapping[N];
+		static const size_t nDense;
+		static const MappedValue<DeclKey, STRUCT> *const dense[];
 
 		static const STRUCT &get(const DeclKey *key) {
-			for(size_t i = 0; i < N; i++)
-				if(mapping[i].key == key)
-					return *mapping[i].aux;
-			return STRUCT::Default;
+			const MappedValue<DeclKey, STRUCT> *cur = key->ordinal < nDense ? dense[key->ordinal] : nullptr;
+			return cur && cur->key == key ? *cur->aux : STRUCT::Default;
 		}
 	};
 
@@ -545,7 +742,7 @@ namespace spec {
 
 	template<typename STRUCT> struct MappedValue<DeclKey, STRUCT> {
 		const DeclKey *key;
-		const STRUCT aux;
+		const STRUCT *aux;
 	};
 
 	template<typename T, typename INFO, size_t Size> struct EnumInfoImpl {
@@ -558,20 +755,46 @@ namespace spec {
 		}
 
 		static T fromString(const QString &name) {
-			QByteArray utf8 = name.toUtf8();
-			for(size_t i = 0; i < N; i++)
-				if(!strcmp(INFO::DeclObject->enumValues[i].name, utf8.constData()))
-					return static_cast<T>(i);
-			throw SpecException("enum value name not found");
+			quint64 value = findString(name);
+			if(!value)
+				throw SpecException("enum value name not found");
+			return static_cast<T>(value - 1);
+		}
+
+		static T fromString(const char *utf8, size_t len) {
+			quint64 value = findString(utf8, len);
+			if(!value)
+				throw SpecException("enum value name not found");
+			return static_cast<T>(value - 1);
 		}
 
 		//returns a VALUE
 		static quint64 findString(const QString &name) {
-			QByteArray utf8 = name.toUtf8();
-			for(size_t i = 0; i < N; i++)
-				if(!strcmp(INFO::DeclObject->enumValues[i].name, utf8.constData()))
-					return i + 1;
-			return 0;
+			char utf8[INFO::MaxLength + 1];
+			if(size_t(name.size()) > INFO::MaxLength) //utf-8 never has less code units than utf-16
+				return 0;
+			for(int i = 0; i < name.size(); i++) {
+				ushort c = name.at(i).unicode();
+				if(c >= 0x80) {
+					QByteArray tmp = name.toUtf8();
+					return findString(tmp.constData(), tmp.size());
+				}
+				utf8[i] = c;
+			}
+			return findString(utf8, name.size());
+		}
+
+		//returns a VALUE; 'utf8' needs not be null-terminated
+		static quint64 findString(const char *utf8, size_t len) {
+			if(len > INFO::MaxLength)
+				return 0;
+			quint64 value = INFO::HashTable[nameHash(INFO::HashSeed, utf8, len) & (INFO::HashSize - 1)];
+			if(!value)
+				return 0;
+			const char *name = INFO::DeclObject->enumValues[value - 1].name;
+			if(strncmp(name, utf8, len) || name[len])
+				return 0;
+			return value;
 		}
 
 		static constexpr T fromIndex(quint64 value) {
@@ -657,6 +880,17 @@ namespace spec {
 		}
 	};
 
+	//specialized by specgen for full keys without flexible fields (see KeyEditor for the general case)
+	template<typename T> struct KeyCodec;
+
+	template<typename T> static inline void keyPut(char *data, T value) {
+		qToBigEndian<T>(value, reinterpret_cast<uchar*>(data));
+	}
+
+	template<typename T> static inline T keyGet(const char *data) {
+		return qFromBigEndian<T>(reinterpret_cast<const uchar*>(data));
+	}
+
 	template<typename T> static inline void setEnumNull(T *enm) {
 		*enm = static_cast<T>(0);
 	}
@@ -670,6 +904,15 @@ namespace spec {
 	}
 
 #include "../spec/spec-1.0.h"
+
+	//statically dispatched alternative to Value::constWalk. the visitor provides down(Name, size_t n), up(), begin(size_t index), end()
+	//and a template var(size_t index, const DeclType *type, const T &value), receiving the member itself
+	template<typename V> void walk(const Value &value, V &visitor) {
+		if(value.decl()->meta == &v1_0::meta)
+			v1_0::walk(value, visitor);
+		else
+			Q_ASSERT(false);
+	}
 }
 #undef _IN_SPEC_H
 
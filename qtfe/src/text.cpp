@@ -20,6 +20,7 @@ void TextFragmenter::update()
 
 	_lines = _text.split("\n");
 	_words.clear();
+	_parstart.clear();
 	_lines.clear();
 	_npar = 0;
 
@@ -83,6 +84,7 @@ void TextFragmenter::update()
 			if(state == ParBegin) {
 				word.pidx++;
 				word.widx = 0;
+				_parstart.append(nword);
 				state = LineBegin;
 			}
 			if(state == LineBegin || state == BetweenWord) {
@@ -121,16 +123,47 @@ int TextFragmenter::paragraphs() const
 
 bool TextFragmenter::word(int p, int w, int *start, int *end) const
 {
-	for(auto cur : _words) {
-		if(cur.pidx == p && cur.widx == w) {
-			if(start)
-				*start = cur.begin;
-			if(end)
-				*end = cur.end;
-			return true;
-		}
-	}
-	return false;
+	int idx = wordIndex(p, w);
+	if(idx < 0)
+		return false;
+	if(start)
+		*start = _words.at(idx).begin;
+	if(end)
+		*end = _words.at(idx).end;
+	return true;
+}
+
+int TextFragmenter::wordIndex(int p, int w) const
+{
+	if(p < 1 || p > _parstart.size() || w < 1)
+		return -1;
+	int idx = _parstart.at(p - 1) + w - 1;
+	if(idx >= _words.size() || _words.at(idx).pidx != p)
+		return -1;
+	return idx;
+}
+
+void TextFragmenter::wordAt(int idx, int *p, int *w) const
+{
+	if(p)
+		*p = _words.at(idx).pidx;
+	if(w)
+		*w = _words.at(idx).widx;
+}
+
+int TextFragmenter::wordBegin(int idx) const
+{
+	return _words.at(idx).begin;
+}
+
+int TextFragmenter::wordEnd(int idx) const
+{
+	return _words.at(idx).end;
+}
+
+QStringRef TextFragmenter::wordRef(int idx) const
+{
+	return _text.midRef(_words.at(idx).begin, _words.at(idx).end - _words.at(idx).begin);
 }
 
 bool TextFragmenter::word(int pos, int *p, int *w) const
@@ -153,6 +186,194 @@ bool TextFragmenter::word(int pos, int *p, int *w) const
 	return true;
 }
 
+TextRebaser::TextRebaser(const TextFragmenter &from, const TextFragmenter &to)
+	:	_from(from),
+		_to(to),
+		_stable(0),
+		_prefix(0),
+		_oldEnd(from.words()),
+		_newEnd(to.words())
+{
+	QString oldText = from.text();
+	QString newText = to.text();
+	int nchar = qMin(oldText.size(), newText.size());
+	int c = 0;
+
+	//words ending before the first changed character (including the character terminating the word) are untouched
+	while(c < nchar && oldText.at(c) == newText.at(c))
+		c++;
+	if(c == oldText.size() && c == newText.size()) {
+		_stable = _prefix = _oldEnd = from.words();
+		_newEnd = to.words();
+		return;
+	}
+	int lo = 0;
+	int hi = from.words();
+	while(lo < hi) {
+		int mid = (lo + hi) / 2;
+		if(from.wordEnd(mid) < c)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	_stable = lo;
+
+	//extend to common word prefix/suffix; these words only change index and coordinates
+	_prefix = _stable;
+	while(_prefix < _oldEnd && _prefix < _newEnd && from.wordRef(_prefix) == to.wordRef(_prefix))
+		_prefix++;
+	while(_oldEnd > _prefix && _newEnd > _prefix && from.wordRef(_oldEnd - 1) == to.wordRef(_newEnd - 1)) {
+		_oldEnd--;
+		_newEnd--;
+	}
+	diff();
+}
+
+void TextRebaser::diff()
+{
+	int n = _oldEnd - _prefix;
+	int m = _newEnd - _prefix;
+
+	_map.fill(-1, n);
+	if(!n || !m)
+		return;
+
+	//linear space: both vectors are shared by all levels of the recursion, which is O(log D) deep
+	int max = (n + m + 1) / 2;
+	QVector<int> forward(2 * max + 3, 0);
+	QVector<int> backward(2 * max + 3, 0);
+	diff(_prefix, _oldEnd, _prefix, _newEnd, forward, backward);
+}
+
+//Hirschberg: split the old range [a0, a1) and the new range [b0, b1) at the middle snake of an optimal path and recurse on both halves
+void TextRebaser::diff(int a0, int a1, int b0, int b1, QVector<int> &forward, QVector<int> &backward)
+{
+	while(a0 < a1 && b0 < b1 && same(a0, b0))
+		_map[a0++ - _prefix] = b0++;
+	while(a0 < a1 && b0 < b1 && same(a1 - 1, b1 - 1))
+		_map[--a1 - _prefix] = --b1;
+	if(a0 == a1 || b0 == b1)
+		return;
+
+	int x0;
+	int y0;
+	int x1;
+	int y1;
+	middleSnake(a0, a1, b0, b1, forward, backward, &x0, &y0, &x1, &y1);
+	for(int x = x0, y = y0; x < x1; x++, y++)
+		_map[x - _prefix] = y;
+	diff(a0, x0, b0, y0, forward, backward);
+	diff(x1, a1, y1, b1, forward, backward);
+}
+
+//Myers' middle snake: greedy passes from both ends, alternating by edit distance, until they overlap. the snake (x0, y0) -> (x1, y1) is
+//in absolute word indices. both ends of the ranges must differ, so a snake is found for d > 0 and the halves are smaller than the range.
+void TextRebaser::middleSnake(int a0, int a1, int b0, int b1, QVector<int> &forward, QVector<int> &backward, int *x0, int *y0, int *x1, int *y1) const
+{
+	int n = a1 - a0;
+	int m = b1 - b0;
+	int delta = n - m;
+	bool odd = delta & 1;
+	int max = (n + m + 1) / 2;
+	int off = max + 1;
+
+	//forward[off + k]: furthest x on diagonal k = x - y from the start; backward[off + k]: the same from the end, x and y counted backwards
+	forward[off + 1] = 0;
+	backward[off + 1] = 0;
+	for(int d = 0; d <= max; d++) {
+		for(int k = -d; k <= d; k += 2) {
+			int x;
+			if(k == -d || (k != d && forward[off + k - 1] < forward[off + k + 1]))
+				x = forward[off + k + 1];
+			else
+				x = forward[off + k - 1] + 1;
+			int y = x - k;
+			int sx = x;
+			int sy = y;
+			while(x < n && y < m && same(a0 + x, b0 + y)) {
+				x++;
+				y++;
+			}
+			forward[off + k] = x;
+			if(odd && k >= delta - (d - 1) && k <= delta + (d - 1) && x + backward[off + delta - k] >= n) {
+				*x0 = a0 + sx;
+				*y0 = b0 + sy;
+				*x1 = a0 + x;
+				*y1 = b0 + y;
+				return;
+			}
+		}
+		for(int k = -d; k <= d; k += 2) {
+			int x;
+			if(k == -d || (k != d && backward[off + k - 1] < backward[off + k + 1]))
+				x = backward[off + k + 1];
+			else
+				x = backward[off + k - 1] + 1;
+			int y = x - k;
+			int sx = x;
+			int sy = y;
+			while(x < n && y < m && same(a1 - x - 1, b1 - y - 1)) {
+				x++;
+				y++;
+			}
+			backward[off + k] = x;
+			if(!odd && delta - k >= -d && delta - k <= d && x + forward[off + delta - k] >= n) {
+				*x0 = a1 - x;
+				*y0 = b1 - y;
+				*x1 = a1 - sx;
+				*y1 = b1 - sy;
+				return;
+			}
+		}
+	}
+	Q_ASSERT(false);
+}
+
+bool TextRebaser::affected(int p, int w) const
+{
+	int idx = _from.wordIndex(p, w);
+	return idx < 0 || idx >= _stable;
+}
+
+bool TextRebaser::map(int *p, int *w, Anchor anchor) const
+{
+	int idx = _from.wordIndex(*p, *w);
+	int nidx;
+	bool kept = true;
+
+	if(idx < 0 || !_to.words())
+		return false;
+	else if(idx < _prefix)
+		nidx = idx;
+	else if(idx >= _oldEnd)
+		nidx = idx - _oldEnd + _newEnd;
+	else {
+		nidx = _map.at(idx - _prefix);
+		if(nidx < 0) {
+			kept = false;
+			if(anchor == AnchorBegin) {
+				nidx = _newEnd;
+				for(int i = idx - _prefix + 1; i < _map.size(); i++)
+					if(_map.at(i) >= 0) {
+						nidx = _map.at(i);
+						break;
+					}
+			}
+			else {
+				nidx = _prefix - 1;
+				for(int i = idx - _prefix - 1; i >= 0; i--)
+					if(_map.at(i) >= 0) {
+						nidx = _map.at(i);
+						break;
+					}
+			}
+			nidx = qBound(0, nidx, _to.words() - 1);
+		}
+	}
+	_to.wordAt(nidx, p, w);
+	return kept;
+}
+
 /*int TextFragmenter::line(int pos, int *linepos)
 {
 	auto it = _linepos.upperBound(pos);
@@ -46,6 +46,12 @@ class TextFragmenter {
 		bool word(int pos, int *p = nullptr, int *w = nullptr) const;
 		int words() const;
 		int paragraphs() const;
+
+		int wordIndex(int p, int w) const; //returns -1, if word does not exist
+		void wordAt(int idx, int *p, int *w) const;
+		int wordBegin(int idx) const;
+		int wordEnd(int idx) const;
+		QStringRef wordRef(int idx) const;
 //		int line(int pos, int *linepos = nullptr); //linepos: position in line, where 'pos' can be found
 
 	private:
@@ -63,10 +69,39 @@ class TextFragmenter {
 		QStringList _lines;
 //		QMap<int, int> _linepos; //[end position] -> [line index]; use _linepos.upperBounds(globalPos) to get iterator to line, where globalPos character can be found.
 		QVector<Word> _words;
+		QVector<int> _parstart; //[paragraph index - 1] -> index of first word
 		int _npar;
 //		QMap<int, int> _par
 };
 
+//Maps word coordinates of an old text version to a new one. Only the region between
+//the common word prefix and suffix is diffed (Myers in linear space, word granularity).
+class TextRebaser {
+	public:
+		enum Anchor {
+			AnchorBegin, AnchorEnd
+		};
+
+		TextRebaser(const TextFragmenter &from, const TextFragmenter &to);
+
+		bool affected(int p, int w) const; //whether coordinates of word (p, w) may have changed
+		bool map(int *p, int *w, Anchor anchor) const; //returns false, if the word has been deleted; p and w are moved to the nearest surviving word in that case
+
+	private:
+		void diff();
+		void diff(int a0, int a1, int b0, int b1, QVector<int> &forward, QVector<int> &backward);
+		void middleSnake(int a0, int a1, int b0, int b1, QVector<int> &forward, QVector<int> &backward, int *x0, int *y0, int *x1, int *y1) const;
+		bool same(int a, int b) const { return _from.wordRef(a) == _to.wordRef(b); } //old word a equals new word b
+
+		const TextFragmenter &_from;
+		const TextFragmenter &_to;
+		int _stable; //words before this index keep their coordinates
+		int _prefix; //words before this index keep their index
+		int _oldEnd; //old words starting at this index are shifted by _newEnd - _oldEnd
+		int _newEnd;
+		QVector<int> _map; //[old index - _prefix] -> new index or -1 for words in the changed region
+};
+
 class NameListParser {
 
 };
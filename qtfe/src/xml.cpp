@@ -1,4 +1,9 @@
+#include <algorithm>
+
 #include <QFile>
+#include <QSet>
+#include <QSaveFile>
+#include <QXmlStreamReader>
 #include <QXmlStreamWriter>
 
 #include "common/qXml.h"
@@ -15,160 +20,315 @@ namespace { namespace xmlold {
 }}
 
 namespace {
-	struct ValueFrame : XmlModelHandlerFrame {
-		ValueFrame(const DeclValue *decl, const DeclVar *vars, size_t nvar, const ValueAccessor *accessor, void *handle) : decl(decl), vars(vars), nvar(nvar), accessor(accessor), handle(handle) {}
+	const int BatchSize = 256; //number of values parsed, before they are inserted into the frontend
+
+	//hash table lookup with QStringRef, so element and attribute names don't have to be copied
+	template<typename T> class NameTable {
+		public:
+			void insert(const QString &name, T value) {
+				_table.insert(qHash(name), Entry{ name, value });
+			}
 
-		const DeclValue *decl;
-		const DeclVar *vars;
-		size_t nvar;
-		const ValueAccessor *accessor;
-		void *handle;
+			T find(const QStringRef &name) const {
+				uint hash = qHash(name);
+				for(auto it = _table.constFind(hash); it != _table.constEnd() && it.key() == hash; ++it)
+					if(it->name == name)
+						return it->value;
+				return T();
+			}
 
-		QMap<const DeclVar*, size_t> n;
+		private:
+			struct Entry {
+				QString name;
+				T value;
+			};
+
+			QMultiHash<uint, Entry> _table;
+	};
+
+	struct KeyDispatch {
+		const DeclKey *key;
+		NameTable<const DeclField*> fields;
 	};
 
-#if 0
-	struct Element : XmlModelHandlerFrame {
-		QMap<Name, size_t> ncell;
+	struct VarDispatch {
+		NameTable<const DeclVar*> names;
+		size_t n; //number of vars in block
 	};
-#endif
 
-	class Handler : public XmlModelHandler {
+	//pull parser for the xml format written by XmlFormat::save(); keeps one value per open key element and at most BatchSize parsed values in memory.
+	//for undo(), the imported keys and the values they replaced are kept as well
+	class Loader {
 		public:
-			Handler(SyncFrontend *fe) : _fe(fe), _spec(nullptr) {
-				int root = add(cb(this, &Handler::start));
-				int key = add(cb(this, &Handler::keyStart));
-				int value = add(cb(this, &Handler::valueStart));
-
-				link(0, "annotate-db", root);
-				link(root, key);
-				link(key, value);
-				link(value, value);
+			Loader(SyncFrontend *fe, QXmlStreamReader *reader, QIODevice *device, const XmlFormat::Progress &progress) : _fe(fe), _reader(reader), _device(device), _progress(progress), _value(nullptr) {
+				const DeclMeta *meta = fe->spec();
+				_keys.resize(meta->nKeys);
+				for(size_t i = 0; i < meta->nKeys; i++) {
+					const DeclKey *key = meta->keys[i];
+					KeyDispatch &dispatch = _keys[i];
+					dispatch.key = key;
+					for(size_t j = 0; j < key->nFields; j++)
+						dispatch.fields.insert(key->fields[j].name, key->fields + j);
+					_keyNames.insert(key->fullname, &dispatch);
+				}
+				for(size_t i = 0; i < meta->nValues; i++) {
+					const DeclValue *decl = meta->values[i];
+					for(size_t j = 0; j < decl->nVars; j++) {
+						const DeclVar *var = decl->vars + j;
+						VarDispatch &dispatch = _vars[decl->vars + var->parent];
+						dispatch.names.insert(name2string(var->name), var);
+						dispatch.n = decl->countVar(var->parent);
+					}
+				}
+			}
+
+			~Loader() {
+				if(_value)
+					_value->decl()->destroy(_value);
+				for(const auto &it : _batch)
+					it.second->decl()->destroy(it.second);
+			}
+
+			//parse everything after the start tag of the root element; returns false, if cancelled
+			bool run() {
+				while(!_reader->atEnd()) {
+					switch(_reader->readNext()) {
+						case QXmlStreamReader::StartElement:
+							if(_frames.isEmpty())
+								keyStart();
+							else
+								varStart();
+							break;
+						case QXmlStreamReader::EndElement:
+							if(_frames.isEmpty()) //end of root element
+								break;
+							_counts.resize(_frames.top().counts);
+							_frames.pop();
+							if(_frames.isEmpty() && !keyEnd())
+								return false;
+							break;
+						default:
+							break;
+					}
+				}
+				if(_reader->hasError())
+					throw XmlModelException(QString("error parsing xml file: %1 (line %2)").arg(_reader->errorString()).arg(_reader->lineNumber()));
+				return flush();
 			}
 
 		private:
-			void start(const QXmlAttributes &attr) {
-				QString attrSpec = attr.value("spec");
-				QString attrXml = attr.value("xml");
-				if(attrSpec.isEmpty())
-					delegate(new xmlold::Handler(_fe));
-				else if(attrXml != "1.0")
-					throw XmlModelException("cannot load xml: unimplemented xml version");
-				else {
-					_spec = DeclMeta::version(attrSpec);
-					if(!_spec)
-						throw XmlModelException("invalid spec version");
-					else if(_spec != _fe->spec())
-						throw XmlModelException("spec version does not match frontend version");
+			struct Frame {
+				const DeclValue *decl;
+				const DeclVar *vars; //first var of the current block; nullptr: leaf entry, which has no children
+				const VarDispatch *dispatch;
+				const ValueAccessor *accessor;
+				void *handle;
+				int counts; //offset of the per var element counts in '_counts'
+			};
+
+			void push(const DeclValue *decl, const DeclVar *vars, const ValueAccessor *accessor, void *handle) {
+				Frame frame;
+				frame.decl = decl;
+				frame.vars = vars;
+				frame.dispatch = nullptr;
+				frame.accessor = accessor;
+				frame.handle = handle;
+				frame.counts = _counts.size();
+				if(vars) {
+					auto it = _vars.constFind(vars);
+					if(it != _vars.constEnd()) {
+						frame.dispatch = &*it;
+						_counts.resize(_counts.size() + it->n);
+						std::fill(_counts.begin() + frame.counts, _counts.end(), 0);
+					}
 				}
+				_frames.push(frame);
 			}
 
-			void keyStart(XmlModelHandlerFrame *&frame, const QString &name, const QXmlAttributes &attr) {
-				const DeclKey *key = _spec->findKey(name);
-				if(!key)
+			void keyStart() {
+				const KeyDispatch *dispatch = _keyNames.find(_reader->name());
+				if(!dispatch)
 					throw XmlModelException("no such key");
-				KeyEditor keyed(key);
-				for(int i = 0; i < attr.length(); i++) {
-					const DeclField *field = key->findField(attr.qName(i));
+				KeyEditor keyed(dispatch->key);
+				for(const auto &attr : _reader->attributes()) {
+					const DeclField *field = dispatch->fields.find(attr.qualifiedName());
 					if(!field)
 						throw XmlModelException("no such field for key");
-					if(field->type->dynamicId) {
-						QString xmlid = attr.value(i);
-						quint64 dbid = _idmap.value(xmlid);
-						if(!dbid) {
-							dbid = _fe->acquire(field->type);
-							_idmap.insert(xmlid, dbid);
-						}
-						keyed.uintPutAt(field->index, dbid);
-					}
+					if(field->type->dynamicId)
+						keyed.uintPutAt(field->index, mapId(field->type, attr.value()));
 					else
-						keyed.fromstringAt(field->index, attr.value(i));
+						keyed.fromstringAt(field->index, attr.value().toString());
 				}
 				const DeclValue *mapto = keyed.mapto();
 				if(!mapto)
 					throw XmlModelException("invalid key: does not map to a value");
-				Value *value = _fe->get(keyed, true);
-				if(value->decl() != mapto)
-					throw XmlModelException("internal error: keyed.mapto() doesn't match returned value in qtfe/xml.cpp");
-				frame = new ValueFrame(mapto, mapto->vars, mapto->countVar(0), mapto->accessor, value);
+				_key = keyed;
+				_value = static_cast<Value*>(mapto->create());
+				push(mapto, mapto->vars, mapto->accessor, _value);
+			}
+
+			bool keyEnd() {
+				_batch.append(qMakePair(_key, _value));
+				_value = nullptr;
+				return _batch.size() < BatchSize || flush();
 			}
 
-			void valueStart(XmlModelHandlerFrame *&frame, const QString &namestr, const QXmlAttributes &attr) {
-				ValueFrame *value = frame->topmost<ValueFrame>();
-				Name name = string2name(namestr);
-				QString attrString = attr.value("string");
-				QString attrEnum = attr.value("enum");
-				QString attrUint = attr.value("uint");
-				QString attrSint = attr.value("sint");
-				QString attrId = attr.value("id");
-				if(name == Name::null)
-					throw XmlModelException("no such name");
-//				printf("VALUE: %s %zu\n", qPrintable(name2string(value->decl->name)), value->vars - value->decl->vars);
-				const DeclVar *child = value->decl->findVar(value->vars - value->decl->vars, name);
+			void varStart() {
+				const Frame &top = _frames.top();
+				if(!top.vars)
+					throw XmlModelException("value entry must not have children");
+				const DeclVar *child = top.dispatch ? top.dispatch->names.find(_reader->name()) : nullptr;
 				if(!child)
-					throw XmlModelException(QString("no such value entry '%1'").arg(name2string(name)));
-				size_t index = value->n[child]++;
+					throw XmlModelException(QString("no such value entry '%1'").arg(_reader->name().toString()));
+				size_t rel = child - top.vars;
+				size_t index = _counts[top.counts + rel]++;
 				if(child->n) {
 					if(index >= child->n)
 						throw XmlModelException("too many values for field");
 				}
+				else if(!top.accessor->append(top.handle, rel))
+					throw XmlModelException("error adding field to value");
+				void *handle = top.accessor->child(top.handle, rel, index);
+				if(child->child)
+					push(top.decl, top.decl->vars + child->child, child->u.accessor, handle);
 				else {
-					if(!value->accessor->append(value->handle, child - value->vars))
-						throw XmlModelException("error adding field to value");
+					entry(child->u.type, handle);
+					push(top.decl, nullptr, nullptr, handle);
+				}
+			}
+
+			void entry(const DeclType *type, void *handle) {
+				QXmlStreamAttributes attr = _reader->attributes();
+				if(type->isString()) {
+					if(!attr.hasAttribute("string"))
+						throw XmlModelException("missing 'string' attribute for string entry");
+					type->stringPut(handle, attr.value("string").toString());
 				}
-				void *handle = value->accessor->child(value->handle, child - value->vars, index);
-				if(child->child) {
-					frame = new ValueFrame(value->decl, value->decl->vars + child->child, value->decl->countVar(child->child), child->u.accessor, handle);
+				else if(type->dynamicId) {
+					QStringRef id = attr.value("id");
+					if(id.isEmpty())
+						throw XmlModelException("missing 'id' attribute for id entry");
+					type->uintPut(handle, mapId(type, id));
 				}
-				else {
-					const DeclType *type = child->u.type;
-					if(type->isString()) {
-						if(attrString.isNull())
-							throw XmlModelException("missing 'string' attribute for string entry");
-						type->stringPut(handle, attrString);
-					}
-					else if(type->dynamicId) {
-						if(attrId.isEmpty())
-							throw XmlModelException("missing 'id' attribute for id entry");
-						quint64 dbid = _idmap.value(attrId);
-						if(!dbid) {
-							dbid = _fe->acquire(type);
-							_idmap.insert(attrId, dbid);
+				else if(type->isEnum()) {
+					QStringRef value = attr.value("enum");
+					if(value.isEmpty())
+						throw XmlModelException("missing 'enum' attribute for enum entry");
+					//TODO unify this with fromstring in DeclType and key.cpp
+					QByteArray utf8 = value.toUtf8();
+					ssize_t enumidx = type->nameIndexOf(utf8.constData());
+					if(enumidx < 0)
+						type->uintPut(handle, 0);
+					else
+						type->uintPut(handle, enumidx + 1);
+				}
+				else if(type->isUnsigned()) {
+					QStringRef value = attr.value("uint");
+					if(value.isEmpty())
+						throw XmlModelException("missing 'uint' attribute for uint entry");
+					//TODO check, if value is ok
+					type->uintPut(handle, value.toULongLong());
+				}
+				else if(type->isSigned()) {
+					QStringRef value = attr.value("sint");
+					if(value.isEmpty())
+						throw XmlModelException("missing 'sint' attribute for sint entry");
+					//TODO check, if value is ok
+					type->sintPut(handle, value.toLongLong());
+				}
+			}
+
+			quint64 mapId(const DeclType *type, const QStringRef &xmlid) {
+				QString id = xmlid.toString();
+				quint64 dbid = _idmap.value(id);
+				if(!dbid) {
+					dbid = _fe->acquire(type);
+					_idmap.insert(id, dbid);
+				}
+				return dbid;
+			}
+
+		public:
+			//revert everything inserted so far: imported keys are erased, overwritten ones get their previous value back.
+			//also committed in batches, so a crash while undoing leaves part of the import behind
+			void undo() {
+				int n = 0;
+				_fe->begin();
+				try {
+					for(const auto &key : _imported) {
+						auto it = _overwritten.constFind(key);
+						if(it == _overwritten.constEnd())
+							_fe->erase(key);
+						else {
+							Value *value = _fe->get(key, true);
+							BinaryReader reader(_fe->spec(), it->constData(), it->size());
+							if(!value->deserialize(reader))
+								throw XmlModelException("cannot undo import: malformed value");
+							_fe->modified(key);
+						}
+						if(!(++n % BatchSize)) {
+							_fe->commit();
+							_fe->begin();
 						}
-						type->uintPut(handle, dbid);
-					}
-					else if(type->isEnum()) {
-						if(attrEnum.isEmpty())
-							throw XmlModelException("missin 'enum' attribute for enum entry");
-						//TODO unify this with fromstring in DeclType and key.cpp
-						QByteArray utf8 = attrEnum.toUtf8();
-						ssize_t enumidx = type->nameIndexOf(utf8.constData());
-						if(enumidx < 0)
-							type->uintPut(handle, 0);
-						else
-							type->uintPut(handle, enumidx + 1);
-					}
-					else if(type->isUnsigned()) {
-						if(attrUint.isEmpty())
-							throw XmlModelException("missing 'uint' attribute for uint entry");
-						quint64 value = attrUint.toULongLong();
-						//TODO check, if value is ok
-						type->uintPut(handle, value);
 					}
-					else if(type->isSigned()) {
-						if(attrSint.isEmpty())
-							throw XmlModelException("missing 'sint' attribute for uint entry");
-						qint64 value = attrSint.toLongLong();
-						//TODO check, if value is ok
-						type->sintPut(handle, value);
+				}
+				catch(...) {
+					_fe->rollback();
+					throw;
+				}
+				_fe->commit();
+				_imported.clear();
+				_overwritten.clear();
+			}
+
+		private:
+			//insert the parsed values in key order, so that consecutive inserts hit neighbouring nodes of the store.
+			//every batch is committed on its own: a journaled frontend writes one bounded batch each, instead of the whole import at once
+			bool flush() {
+				std::stable_sort(_batch.begin(), _batch.end(), [](const QPair<QByteArray, Value*> &a, const QPair<QByteArray, Value*> &b) {
+					return a.first < b.first;
+				});
+				_fe->begin();
+				try {
+					while(!_batch.isEmpty()) {
+						QPair<QByteArray, Value*> it = _batch.takeFirst();
+						if(!_imported.contains(it.first)) {
+							if(const Value *cur = _fe->get(it.first)) {
+								QByteArray data;
+								BinaryWriter writer(&data);
+								cur->serialize(writer);
+								_overwritten.insert(it.first, data);
+							}
+							_imported.insert(it.first);
+						}
+						_fe->insert(it.first, it.second);
 					}
 				}
+				catch(...) {
+					_fe->rollback();
+					throw;
+				}
+				_fe->commit();
+				return !_progress || _progress(_device->pos(), _device->size());
 			}
 
 			SyncFrontend *_fe;
-			const DeclMeta *_spec;
-
-			QMap<QString, quint64> _idmap;
+			QXmlStreamReader *_reader;
+			QIODevice *_device;
+			XmlFormat::Progress _progress;
+
+			QVector<KeyDispatch> _keys;
+			NameTable<const KeyDispatch*> _keyNames;
+			QHash<const DeclVar*, VarDispatch> _vars; //first var of a block -> names of the vars in that block
+
+			QStack<Frame> _frames;
+			QVector<size_t> _counts;
+			QByteArray _key;
+			Value *_value; //value of the current key element
+			QList<QPair<QByteArray, Value*>> _batch;
+			QHash<QString, quint64> _idmap;
+			QSet<QByteArray> _imported; //keys inserted by committed batches
+			QHash<QByteArray, QByteArray> _overwritten; //[key] -> serialized value replaced by the import
 	};
 }
 
@@ -177,85 +337,170 @@ XmlFormat::XmlFormat(SyncFrontend *fe)
 {
 }
 
-void XmlFormat::load(const QString &filename)
+void XmlFormat::setProgress(const Progress &progress)
 {
-	XmlModelLoader loader;
-	if(!loader.parse(filename, new Handler(_fe)))
-		throw XmlModelException("Error parsing xml file");
+	_progress = progress;
 }
 
-void XmlFormat::save(const QString &filename)
+bool XmlFormat::load(const QString &filename)
 {
-	Value::ConstWalker walker;
-	QStack<Name> names;
-
 	QFile file(filename);
-	if(!file.open(QFile::ReadWrite | QFile::Truncate))
-		throw XmlModelException("error opening xml output file");
-	QByteArray prefix;
-	QXmlStreamWriter writer(&file);
-	writer.setAutoFormatting(true);
-
-	writer.writeStartElement("annotate-db");
-	writer.writeAttribute("xml", "1.0");
-	writer.writeAttribute("spec", _fe->spec()->name);
-
-	walker.down = [&](Name name, size_t n) {
-		names.push(name);
-	};
+	if(!file.open(QFile::ReadOnly))
+		throw XmlModelException("error opening xml input file");
+	QXmlStreamReader reader(&file);
+	if(!reader.readNextStartElement() || reader.name() != "annotate-db")
+		throw XmlModelException("cannot load xml: missing 'annotate-db' root element");
+	QXmlStreamAttributes attr = reader.attributes();
+	if(!attr.hasAttribute("spec"))
+		return loadLegacy(filename);
+	else if(attr.value("xml") != "1.0")
+		throw XmlModelException("cannot load xml: unimplemented xml version");
+	const DeclMeta *spec = DeclMeta::version(attr.value("spec").toString());
+	if(!spec)
+		throw XmlModelException("invalid spec version");
+	else if(spec != _fe->spec())
+		throw XmlModelException("spec version does not match frontend version");
+
+	Loader loader(_fe, &reader, &file, _progress);
+	bool done;
+	//batches are committed as they are parsed; a failed or cancelled import is undone by the loader
+	try {
+		done = loader.run();
+	}
+	catch(...) {
+		loader.undo();
+		throw;
+	}
+	if(!done)
+		loader.undo();
+	return done;
+}
 
-	walker.up = [&]() {
-		names.pop();
-	};
+//files written before the 'spec' attribute existed; these are small, so they are still read through the handler based loader without progress reports
+bool XmlFormat::loadLegacy(const QString &filename)
+{
+	XmlModelLoader loader;
+	_fe->begin();
+	try {
+		if(!loader.parse(filename, new xmlold::Handler(_fe)))
+			throw XmlModelException("Error parsing xml file");
+	}
+	catch(...) {
+		_fe->rollback();
+		throw;
+	}
+	_fe->commit();
+	return true;
+}
 
-	walker.begin = [&](size_t index, const ValueAccessor *accessor, const void *handle) {
-		if(names.size() > 1) //don't write value type
-			writer.writeStartElement(name2string(names.top()));
+namespace {
+	struct SaveVisitor {
+		SaveVisitor(QXmlStreamWriter *writer) : writer(writer) {}
+
+		void down(Name name, size_t n) {
+			names.push(name);
+		}
+
+		void up() {
+			names.pop();
+		}
+
+		void begin(size_t index) {
+			if(names.size() > 1) //don't write value type
+				writer->writeStartElement(name2string(names.top()));
+		}
+
+		void end() {
+			if(names.size() > 1) //don't write value type
+				writer->writeEndElement();
+		}
+
+		template<typename T> void var(size_t index, const DeclType *type, const T &value) {
+			const void *handle = &value;
+			writer->writeStartElement(name2string(names.top()));
+			if(type->isString())
+				writer->writeAttribute("string", type->tostring(handle));
+			else if(type->dynamicId)
+				writer->writeAttribute("id", QString("%1:%2").arg(type->fullname).arg(type->tostring(handle)));
+			else if(type->isEnum())
+				writer->writeAttribute("enum", type->tostring(handle));
+			else if(type->isSigned())
+				writer->writeAttribute("sint", type->tostring(handle));
+			else if(type->isUnsigned())
+				writer->writeAttribute("uint", type->tostring(handle));
+			else
+				throw XmlModelException("cannot write value: missing implementation");
+			writer->writeEndElement();
+		}
+
+		QXmlStreamWriter *writer;
+		QStack<Name> names;
 	};
+}
 
-	walker.end = [&]() {
-		if(names.size() > 1) //don't write value type
-			writer.writeEndElement();
+namespace {
+	//element and attribute names of a key type, built once per save
+	struct KeyNames {
+		QString element;
+		QVector<QString> fields;
+		QVector<QString> idPrefix; //"<type>:" for dynamic id fields, otherwise empty
 	};
+}
 
-	walker.var = [&](size_t index, const DeclType *type, const void *handle) {
-		writer.writeStartElement(name2string(names.top()));
-		if(type->isString())
-			writer.writeAttribute("string", type->tostring(handle));
-		else if(type->dynamicId)
-			writer.writeAttribute("id", QString("%1:%2").arg(type->fullname).arg(type->tostring(handle)));
-		else if(type->isEnum())
-			writer.writeAttribute("enum", type->tostring(handle));
-		else if(type->isSigned())
-			writer.writeAttribute("sint", type->tostring(handle));
-		else if(type->isUnsigned())
-			writer.writeAttribute("uint", type->tostring(handle));
-		else
-			throw XmlModelException("cannot write value: missing implementation");
-		writer.writeEndElement();
-	};
+bool XmlFormat::save(const QString &filename)
+{
+	QSaveFile file(filename); //a failed or cancelled save keeps the previous file
+	if(!file.open(QFile::WriteOnly))
+		throw XmlModelException("error opening xml output file");
+	QXmlStreamWriter writer(&file);
+	writer.setAutoFormatting(true);
+	SaveVisitor visitor(&writer);
+	QHash<const DeclKey*, KeyNames> names;
 
+	writer.writeStartElement("annotate-db");
+	writer.writeAttribute("xml", "1.0");
+	writer.writeAttribute("spec", _fe->spec()->name);
 
-	_fe->foreachKV([&](const QByteArray &key, const Value *value) {
-		KeyEditor keyed(_fe->spec(), key);
+	SyncFrontend::ScanGuard guard(_fe); //lazy frontends: make all values resident and keep them until the export is done
+	size_t n = _fe->size();
+	for(size_t i = 0; i < n; i++) {
+		if(_progress && !(i % BatchSize) && !_progress(i, n)) {
+			file.cancelWriting();
+			return false;
+		}
+		KeyEditor keyed(_fe->spec(), _fe->key(i));
 		if(!keyed.isValidKey())
 			throw XmlModelException("cannot save xml: database contains invalid keys");
-		writer.writeStartElement(keyed.name());
-
-		for(size_t i = 0; i < keyed.fields(); i++)
-			if(!keyed.isKeyFieldAt(i)) {
-				if(keyed.typeAt(i)->dynamicId)
-					writer.writeAttribute(keyed.fieldNameAt(i), QString("%1:%2").arg(keyed.typeAt(i)->fullname).arg(keyed.tostringAt(i)));
+		auto it = names.find(keyed.decl());
+		if(it == names.end()) {
+			KeyNames keynames;
+			keynames.element = keyed.name();
+			for(size_t j = 0; j < keyed.decl()->nFields; j++) {
+				const DeclField *field = keyed.decl()->fields + j;
+				keynames.fields.append(field->name);
+				keynames.idPrefix.append(field->type->dynamicId ? QString("%1:").arg(field->type->fullname) : QString());
+			}
+			it = names.insert(keyed.decl(), keynames);
+		}
+		writer.writeStartElement(it->element);
+
+		for(size_t j = 0; j < keyed.fields(); j++)
+			if(!keyed.isKeyFieldAt(j)) {
+				if(it->idPrefix.at(j).isEmpty())
+					writer.writeAttribute(it->fields.at(j), keyed.tostringAt(j));
 				else
-					writer.writeAttribute(keyed.fieldNameAt(i), keyed.tostringAt(i));
+					writer.writeAttribute(it->fields.at(j), it->idPrefix.at(j) + keyed.tostringAt(j));
 			}
 
-		value->constWalk(walker);
+		walk(*_fe->value(i), visitor);
 
 		writer.writeEndElement();
-		return true;
-	});
+	}
 
 	writer.writeEndElement();
+	if(writer.hasError() || !file.commit())
+		throw XmlModelException("error writing xml output file");
+	if(_progress)
+		_progress(n, n);
+	return true;
 }
-
@@ -1,16 +1,27 @@
 #pragma once
 
+#include <functional>
+
 #include "types.h"
 #include "spec.h"
 
 class XmlFormat {
 	public:
+		//called with the amount of work done and the total amount (bytes while loading, keys while saving); return false to cancel
+		typedef std::function<bool(qint64 done, qint64 total)> Progress;
+
 		XmlFormat(SyncFrontend *fe);
 
-		void load(const QString &filename);
-		void save(const QString &filename);
+		void setProgress(const Progress &progress);
+
+		//both return false, if cancelled by the progress callback. a cancelled load leaves the frontend unchanged, a cancelled save leaves an existing file untouched.
+		bool load(const QString &filename);
+		bool save(const QString &filename);
 
 	private:
+		bool loadLegacy(const QString &filename);
+
 		SyncFrontend *_fe;
+		Progress _progress;
 };
 
@@ -1,6 +1,7 @@
 #include <QFile>
 #include <QTextStream>
 #include <QSet>
+#include <QVector>
 #include <QCommandLineParser>
 #include <QCoreApplication>
 
@@ -15,6 +16,16 @@ namespace {
 			words[i][0] = words[i][0].toUpper();
 		return words.join("");
 	}
+
+	//must match spec::nameHash()
+	quint32 nameHash(quint32 seed, const QByteArray &data) {
+		quint32 hash = 2166136261u ^ seed;
+		for(auto c : data) {
+			hash ^= quint8(c);
+			hash *= 16777619u;
+		}
+		return hash;
+	}
 }
 
 
@@ -82,6 +93,40 @@ int main(int argn, char **argv)
 	p.pr("};").upn();
 	p.pr("static constexpr const size_t nNames = ").pr(namesList.size() + maxKeyDepth + 1).pr(";").pn();
 
+	//perfect hash over all names (except null) for string2name()
+	QList<QByteArray> hashed;
+	size_t maxLength = 0;
+	hashed.append(QByteArray());
+	for(size_t i = 0; i < maxKeyDepth; i++)
+		hashed.append(QByteArray::number(qulonglong(i)));
+	for(auto it : namesList)
+		hashed.append(it.toLatin1());
+	for(auto it : hashed)
+		maxLength = qMax(maxLength, size_t(it.size()));
+	size_t hashSize = 1;
+	while(hashSize < size_t(hashed.size()))
+		hashSize <<= 1;
+	quint32 hashSeed = 0;
+	QVector<quint16> hashTable;
+	for(bool done = false; !done;) {
+		hashTable.fill(0, hashSize);
+		done = true;
+		for(int i = 1; i < hashed.size() && done; i++) {
+			quint16 &slot = hashTable[nameHash(hashSeed, hashed.at(i)) & (hashSize - 1)];
+			if(slot)
+				done = false;
+			else
+				slot = i;
+		}
+		if(!done && ++hashSeed == 4096) {
+			hashSeed = 0;
+			hashSize <<= 1;
+		}
+	}
+	p.pr("static constexpr const size_t nameMaxLength = ").pr(maxLength).pr(";").pn();
+	p.pr("static constexpr const quint32 nameHashSeed = ").pr(hashSeed).pr(";").pn();
+	p.pr("static constexpr const size_t nameHashSize = ").pr(hashSize).pr(";").pn();
+
 	p.pr("#ifdef IMPLEMENTATION").pn();
 	p.pr("const QString names[] = {").pni();
 	p.pr("nullptr,").pn();
@@ -90,6 +135,10 @@ int main(int argn, char **argv)
 	for(auto it : namesList)
 		p.pr("\"").pr(it).pr("\",").pn();
 	p.pr("};").upn();
+	p.pr("const quint16 nameHashTable[] = {").pni();
+	for(auto it : hashTable)
+		p.pr(it).pr(",").pn();
+	p.pr("};").upn();
 	p.pr("#endif").pn();
 
 	IoTarget target(&file);
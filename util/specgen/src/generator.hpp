@@ -1,4 +1,6 @@
+#include <QHash>
 #include <QQueue>
+#include <QVector>
 
 class Generator {
 	public:
@@ -9,6 +11,7 @@ class Generator {
 		}
 
 		bool generate(const QString &target) {
+			genOrdinals();
 			genNames();
 
 			QString ns = "v" + _model->version().replace(".", "_");
@@ -41,6 +44,7 @@ class Generator {
 			for(auto it : _model->values()) {
 				genDeclValue(it);
 			}
+			genWalk();
 
 			for(auto it : _model->structs()) {
 				genStruct(it);
@@ -62,6 +66,26 @@ class Generator {
 		}
 
 	private:
+		//dense numbering of declarations; used to index the mapping tables directly
+		void genOrdinals() {
+			_nEnumOrdinals = 0;
+			for(auto it : _model->types()) {
+				_typeOrdinal.insert(it, _typeOrdinal.size());
+				_enumOrdinal.insert(it, _nEnumOrdinals);
+				_nEnumOrdinals += it->enumdef.size();
+			}
+
+			QQueue<KeyData*> subs;
+			for(auto it : _model->keys())
+				subs.enqueue(it);
+			while(!subs.isEmpty()) {
+				KeyData *cur = subs.dequeue();
+				_keyOrdinal.insert(cur, _keyOrdinal.size());
+				for(auto subit : cur->subs)
+					subs.enqueue(subit);
+			}
+		}
+
 		void genNames() {
 			_p.pr("//@maxKeyDepth ").pr(_model->maxKeyDepth()).pn();
 			for(auto it : _model->names())
@@ -89,6 +113,8 @@ class Generator {
 			for(auto it : _model->values()) {
 				_p.pr("extern const DeclValue ").pr(lowername(it->fullname)).pr(";").pn();
 			}
+
+			_p.pr("extern const DeclMeta meta;").pn();
 		}
 
 		void genInfo(const QString &ns) {
@@ -97,7 +123,11 @@ class Generator {
 					//_p.pr("template<> struct EnumInfo<").pr(ns).pr("::").pr(uppername(it->fullname)).pr("> : EnumInfoImpl<").pr(ns).pr("::").pr(uppername(it->fullname)).pr(", ").pr(it->enumdef.size()).pr("> {").pni();
 					_p.pr("template<> struct EnumInfo<").pr(ns).pr("::").pr(uppername(it->fullname)).pr("> : EnumInfoImpl<").pr(ns).pr("::").pr(uppername(it->fullname)).pr(", EnumInfo<").pr(ns).pr("::").pr(uppername(it->fullname)).pr(">, ").pr(it->enumdef.size()).pr("> {").pni();
 					_p.pr("static constexpr const DeclType *DeclObject = &").pr(ns).pr("::").pr(lowername(it->fullname)).pr(";").pn();
+					genEnumHash(it);
 					_p.pr("};").upn();
+					_p.pr("#ifdef IMPLEMENTATION").opn(0);
+					_p.pr("constexpr quint16 EnumInfo<").pr(ns).pr("::").pr(uppername(it->fullname)).pr(">::HashTable[];").pn();
+					_p.pr("#endif").opn(0);
 				}
 				_p.pr("template<> struct TypeInfo<").pr(ns).pr("::").pr(uppername(it->fullname)).pr("> : TypeInfoImpl<").pr(ns).pr("::").pr(uppername(it->fullname)).pr(", TypeInfo<").pr(ns).pr("::").pr(uppername(it->fullname)).pr("> > {").pni();
 				_p.pr("static constexpr const DeclType *DeclObject = &").pr(ns).pr("::").pr(lowername(it->fullname)).pr(";").pn();
@@ -115,20 +145,163 @@ class Generator {
 				_p.pr("template<> struct KeyInfo<").pr(ns).pr("::").pr(uppername(cur->fullname)).pr("> : KeyInfoImpl<").pr(ns).pr("::").pr(uppername(cur->fullname)).pr(", ").pr(nfield).pr("> {").pni();
 				_p.pr("static constexpr const DeclKey *DeclObject = &").pr(ns).pr("::").pr(lowername(cur->fullname)).pr(";").pn();
 				_p.pr("};").upn();
+				genKeyCodec(ns, cur);
 				for(auto subit : cur->subs)
 					subs.enqueue(subit);
 			}
 		}
 
+		//must match spec::nameHash()
+		static quint32 nameHash(quint32 seed, const QByteArray &data) {
+			quint32 hash = 2166136261u ^ seed;
+			for(auto c : data) {
+				hash ^= quint8(c);
+				hash *= 16777619u;
+			}
+			return hash;
+		}
+
+		//perfect hash of the enum names: table slot -> enum value (index + 1), 0 if empty
+		void genEnumHash(TypeData *type) {
+			QList<QByteArray> names;
+			size_t maxlen = 0;
+			for(auto it : type->enumdef) {
+				names.append(it->name.toUtf8());
+				maxlen = qMax(maxlen, size_t(names.last().size()));
+			}
+			size_t size = 1;
+			while(size < size_t(names.size()))
+				size <<= 1;
+			quint32 seed = 0;
+			QVector<quint16> table;
+			for(bool done = false; !done;) {
+				table.fill(0, size);
+				done = true;
+				for(int i = 0; i < names.size() && done; i++) {
+					if(names.at(i).isEmpty() || names.indexOf(names.at(i)) != i)
+						continue;
+					quint16 &slot = table[nameHash(seed, names.at(i)) & (size - 1)];
+					if(slot)
+						done = false;
+					else
+						slot = i + 1;
+				}
+				if(!done && ++seed == 4096) {
+					seed = 0;
+					size <<= 1;
+				}
+			}
+			_p.pr("static constexpr quint32 HashSeed = ").pr(seed).pr(";").pn();
+			_p.pr("static constexpr size_t HashSize = ").pr(size).pr(";").pn();
+			_p.pr("static constexpr size_t MaxLength = ").pr(maxlen).pr(";").pn();
+			_p.pr("static constexpr quint16 HashTable[HashSize] = {");
+			for(size_t i = 0; i < size; i++)
+				_p.pr(i ? ", " : " ").pr(table.at(i));
+			_p.pr(" };").pn();
+		}
+
+		static const char *uintName(size_t size) {
+			switch(size) {
+				case 1: return "quint8";
+				case 2: return "quint16";
+				case 4: return "quint32";
+				case 8: return "quint64";
+				default: return nullptr;
+			}
+		}
+
+		//fixed-layout codec for full keys without flexible fields; offsets are known at compile time
+		void genKeyCodec(const QString &ns, KeyData *key) {
+			if(!key->subs.isEmpty() || key->flexible)
+				return;
+			QList<KeyData*> hierarchy;
+			for(KeyData *it = key; it; it = it->parent)
+				hierarchy.prepend(it);
+			for(auto it : hierarchy)
+				for(auto fit : it->fields)
+					if(!uintName(fit->type->size()))
+						return;
+
+			QString cls = ns + "::" + uppername(key->fullname);
+			QList<size_t> offsets;
+			_p.pr("template<> struct KeyCodec<").pr(cls).pr("> {").pni();
+			_p.pr("static constexpr const DeclKey *DeclObject = &").pr(ns).pr("::").pr(lowername(key->fullname)).pr(";").pn();
+			_p.pr("static constexpr size_t Size = ").pr(key->size).pr(";").pn();
+			for(auto it : hierarchy) {
+				offsets.append(it->offset);
+				for(auto fit : it->fields) {
+					offsets.append(fit->offset);
+					_p.pr(uintName(fit->type->size())).pr(" ").pr(lowername(fit->name)).pr(" = 0;").pn();
+				}
+			}
+			offsets.append(key->size);
+			_p.pr("static constexpr size_t Offsets[").pr(offsets.size()).pr("] = {"); //[field] -> offset; last entry: Size
+			for(int i = 0; i < offsets.size(); i++)
+				_p.pr(i ? ", " : " ").pr(offsets.at(i));
+			_p.pr(" };").pn();
+
+			_p.pr("void encode(char *data) const {").pni();
+			size_t index = 0;
+			for(int i = 0; i < hierarchy.size(); i++) {
+				KeyData *cur = hierarchy.at(i);
+				_p.pr("keyPut<").pr(uintName(offsets.at(index + 1) - offsets.at(index))).pr(">(data + ").pr(cur->offset).pr(", ").pr(cur->index + 1).pr(");").pn();
+				index++;
+				for(auto fit : cur->fields) {
+					_p.pr("keyPut<").pr(uintName(fit->type->size())).pr(">(data + ").pr(fit->offset).pr(", ").pr(lowername(fit->name)).pr(");").pn();
+					index++;
+				}
+			}
+			_p.pr("}").upn();
+
+			_p.pr("bool decode(const char *data, size_t size) {").pni();
+			_p.pr("if(size != Size");
+			index = 0;
+			for(int i = 0; i < hierarchy.size(); i++) {
+				KeyData *cur = hierarchy.at(i);
+				_p.pr(" || keyGet<").pr(uintName(offsets.at(index + 1) - offsets.at(index))).pr(">(data + ").pr(cur->offset).pr(") != ").pr(cur->index + 1);
+				index += 1 + cur->fields.size();
+			}
+			_p.pr(")").pni();
+			_p.pr("return false;").pnu();
+			for(auto it : hierarchy)
+				for(auto fit : it->fields)
+					_p.pr(lowername(fit->name)).pr(" = keyGet<").pr(uintName(fit->type->size())).pr(">(data + ").pr(fit->offset).pr(");").pn();
+			_p.pr("return true;").pn();
+			_p.pr("}").upn();
+
+			_p.pr("bool decode(const QByteArray &key) {").pni();
+			_p.pr("return decode(key.constData(), key.size());").pn();
+			_p.pr("}").upn();
+			_p.pr("};").upn();
+			_p.pr("#ifdef IMPLEMENTATION").opn(0);
+			_p.pr("constexpr size_t KeyCodec<").pr(cls).pr(">::Offsets[];").pn();
+			_p.pr("#endif").opn(0);
+		}
+
 		void genAnonCell() {
 			for(auto it : _model->namedCellContainers()) {
 				_p.pr("struct rec_").pr(it->elemid).pr(" {").pni();
 				genCellStruct(it->cells);
 				_p.pr("};").upn();
 			}
+			genRecVisit();
 			for(auto it : _model->values()) {
 				_p.pr("struct value_").pr(uppername(it->fullname)).pr(" : Value {").pni();
-				_p.pr("virtual const DeclValue *decl() const override { return &").pr(lowername(it->fullname)).pr("; }").pn();
+				_p.pr("static constexpr const DeclValue *DeclObject = &").pr(lowername(it->fullname)).pr(";").pn();
+				_p.pr("virtual const DeclValue *decl() const override { return DeclObject; }").pn();
+				_p.pr("virtual size_t serialSize() const override;").pn();
+				_p.pr("virtual void serialize(BinaryWriter &writer) const override;").pn();
+				_p.pr("virtual bool deserialize(BinaryReader &reader) override;").pn();
+				_p.pr("virtual quint64 contentHash() const override;").pn();
+				_p.pr("template<typename W> void write(W &writer) const; //W: BinaryWriter or ValueHasher").pn();
+				_p.pr("template<typename V> void visit(V &visitor) const {").pni();
+				_p.pr("const value_").pr(uppername(it->fullname)).pr(" &self = *this;").pn();
+				_p.pr("visitor.down(Name::").pr(uppername(it->fullname)).pr(", 1);").pn();
+				_p.pr("visitor.begin(0);").pn();
+				genVisitCells(it->cells);
+				_p.pr("visitor.end();").pn();
+				_p.pr("visitor.up();").pn();
+				_p.pr("}").upn();
 				genCellStruct(it->cells);
 				_p.pr("};").upn();
 			}
@@ -159,6 +332,193 @@ class Generator {
 				_p.pr("Value_").pr(uppername(it->fullname)).pr(" accessor_value_").pr(uppername(it->fullname)).pr(";").pn();
 				_p.pr("#endif").opn(0);
 			}
+
+			genSerial();
+		}
+
+		//statically dispatched traversal, mirroring the callback order of Value::constWalk
+		void genRecVisit() {
+			for(auto it : _model->namedCellContainers())
+				_p.pr("template<typename V> static void recVisit_").pr(it->elemid).pr("(const rec_").pr(it->elemid).pr(" &self, V &visitor);").pn();
+			for(auto it : _model->namedCellContainers()) {
+				_p.pr("template<typename V> static void recVisit_").pr(it->elemid).pr("(const rec_").pr(it->elemid).pr(" &self, V &visitor) {").pni();
+				genVisitCells(it->cells);
+				_p.pr("}").upn();
+			}
+		}
+
+		void genVisitCells(const QList<CellData*> &cells) {
+			QString ns = "v" + _model->version().replace(".", "_");
+			for(auto it : cells) {
+				size_t n = it->n;
+				if(n == 1 && it->parent && it->parent->name.isEmpty())
+					n = it->parent->n;
+				QString member = "self." + lowername(it->name);
+				QString count = n == 0 ? QString("%1.size()").arg(member) : QString::number(n);
+				_p.pr("visitor.down(Name::").pr(uppername(it->name)).pr(", ").pr(count).pr(");").pn();
+				if(n != 1) {
+					_p.pr("for(size_t i = 0; i < size_t(").pr(count).pr("); i++) {").pni();
+					member += "[i]";
+				}
+				QString index = n == 1 ? "0" : "i";
+				VarData *var = it->to<VarData>();
+				if(var) //qualified: a member may share the type's name
+					_p.pr("visitor.var(").pr(index).pr(", &").pr(ns).pr("::").pr(lowername(var->type->fullname)).pr(", ").pr(member).pr(");").pn();
+				else {
+					CellContainerData *container = it->to<CellContainerData>();
+					if(!container) {
+						Q_ASSERT(false);
+					}
+					_p.pr("visitor.begin(").pr(index).pr(");").pn();
+					_p.pr("recVisit_").pr(container->elemid).pr("(").pr(member).pr(", visitor);").pn();
+					_p.pr("visitor.end();").pn();
+				}
+				if(n != 1)
+					_p.pr("}").upn();
+				_p.pr("visitor.up();").pn();
+			}
+		}
+
+		void genWalk() {
+			_p.pr("template<typename V> void walk(const Value &value, V &visitor) {").pni();
+			_p.pr("switch(value.decl()->ordinal) {").pni();
+			for(auto it : _model->values())
+				_p.pr("case ").pr(_model->values().indexOf(it)).pr(": static_cast<const ").pr(uppername(it->fullname)).pr("&>(value).visit(visitor); break;").pn();
+			_p.pr("default: Q_ASSERT(false); break;").pn();
+			_p.pr("}").upn();
+			_p.pr("}").upn();
+		}
+
+		//binary serializers; records get free functions, values override the Value interface.
+		//the write functions are templates, so content hashes are computed over the same stream without materializing it
+		void genSerial() {
+			_p.pr("#ifdef IMPLEMENTATION").opn(0);
+			for(auto it : _model->namedCellContainers()) {
+				QString rec = QString("rec_%1").arg(it->elemid);
+				_p.pr("static size_t recSize_").pr(it->elemid).pr("(const ").pr(rec).pr(" &self);").pn();
+				_p.pr("template<typename W> static void recWrite_").pr(it->elemid).pr("(W &writer, const ").pr(rec).pr(" &self);").pn();
+				_p.pr("static bool recRead_").pr(it->elemid).pr("(BinaryReader &reader, ").pr(rec).pr(" &self);").pn();
+			}
+			for(auto it : _model->namedCellContainers()) {
+				QString rec = QString("rec_%1").arg(it->elemid);
+				_p.pr("static size_t recSize_").pr(it->elemid).pr("(const ").pr(rec).pr(" &self) {").pni();
+				genSerialSize(it->cells);
+				_p.pr("}").upn();
+				_p.pr("template<typename W> static void recWrite_").pr(it->elemid).pr("(W &writer, const ").pr(rec).pr(" &self) {").pni();
+				genSerialWrite(it->cells);
+				_p.pr("}").upn();
+				_p.pr("static bool recRead_").pr(it->elemid).pr("(BinaryReader &reader, ").pr(rec).pr(" &self) {").pni();
+				genSerialRead(it->cells);
+				_p.pr("}").upn();
+			}
+			for(auto it : _model->values()) {
+				QString sname = "value_" + uppername(it->fullname);
+				_p.pr("size_t ").pr(sname).pr("::serialSize() const {").pni();
+				_p.pr("const ").pr(sname).pr(" &self = *this;").pn();
+				genSerialSize(it->cells);
+				_p.pr("}").upn();
+				_p.pr("template<typename W> void ").pr(sname).pr("::write(W &writer) const {").pni();
+				_p.pr("const ").pr(sname).pr(" &self = *this;").pn();
+				genSerialWrite(it->cells);
+				_p.pr("}").upn();
+				_p.pr("void ").pr(sname).pr("::serialize(BinaryWriter &writer) const {").pni();
+				_p.pr("write(writer);").pn();
+				_p.pr("}").upn();
+				_p.pr("quint64 ").pr(sname).pr("::contentHash() const {").pni();
+				_p.pr("ValueHasher hasher(DeclObject->ordinal);").pn();
+				_p.pr("write(hasher);").pn();
+				_p.pr("return hasher.result();").pn();
+				_p.pr("}").upn();
+				_p.pr("bool ").pr(sname).pr("::deserialize(BinaryReader &reader) {").pni();
+				_p.pr(sname).pr(" &self = *this;").pn();
+				genSerialRead(it->cells);
+				_p.pr("}").upn();
+			}
+			_p.pr("#endif").opn(0);
+		}
+
+		void genSerialSize(const QList<CellData*> &cells) {
+			_p.pr("size_t size = 0;").pn();
+			for(auto it : cells) {
+				size_t n = it->n;
+				if(n == 1 && it->parent && it->parent->name.isEmpty())
+					n = it->parent->n;
+				QString member = "self." + lowername(it->name);
+				if(n == 1) {
+					_p.pr("size += ").pr(serialCall(it, "recSize_%1(", "BinaryWriter::sizeOf(", member)).pr(";").pn();
+					continue;
+				}
+				if(n == 0)
+					_p.pr("size += 4;").pn();
+				_p.pr("for(const auto &it : ").pr(member).pr(")").pni();
+				_p.pr("size += ").pr(serialCall(it, "recSize_%1(", "BinaryWriter::sizeOf(", "it")).pr(";").pnu();
+			}
+			_p.pr("return size;").pn();
+		}
+
+		void genSerialWrite(const QList<CellData*> &cells) {
+			for(auto it : cells) {
+				size_t n = it->n;
+				if(n == 1 && it->parent && it->parent->name.isEmpty())
+					n = it->parent->n;
+				QString member = "self." + lowername(it->name);
+				if(n == 1) {
+					_p.pr(serialCall(it, "recWrite_%1(writer, ", "writer.put(", member)).pr(";").pn();
+					continue;
+				}
+				if(n == 0)
+					_p.pr("writer.put(quint32(").pr(member).pr(".size()));").pn();
+				_p.pr("for(const auto &it : ").pr(member).pr(")").pni();
+				_p.pr(serialCall(it, "recWrite_%1(writer, ", "writer.put(", "it")).pr(";").pnu();
+			}
+		}
+
+		void genSerialRead(const QList<CellData*> &cells) {
+			for(auto it : cells) {
+				size_t n = it->n;
+				if(n == 1 && it->parent && it->parent->name.isEmpty())
+					n = it->parent->n;
+				QString member = "self." + lowername(it->name);
+				if(n == 1) {
+					_p.pr("if(!").pr(serialCall(it, "recRead_%1(reader, ", "reader.get(", member)).pr(")").pni();
+					_p.pr("return false;").pnu();
+				}
+				else if(n > 1) {
+					_p.pr("for(auto &it : ").pr(member).pr(") {").pni();
+					_p.pr("if(!").pr(serialCall(it, "recRead_%1(reader, ", "reader.get(", "it")).pr(")").pni();
+					_p.pr("return false;").pnu();
+					_p.pr("}").upn();
+				}
+				else {
+					_p.pr("{").pni();
+					_p.pr("quint32 count;").pn();
+					_p.pr("if(!reader.get(count) || count > reader.remaining())").pni();
+					_p.pr("return false;").pnu();
+					_p.pr(member).pr(".clear();").pn();
+					_p.pr(member).pr(".reserve(count);").pn();
+					_p.pr("while(count--) {").pni();
+					_p.pr(member).pr(".append(decltype(").pr(member).pr(")::value_type());").pn();
+					_p.pr("if(!").pr(serialCall(it, "recRead_%1(reader, ", "reader.get(", member + ".last()")).pr(")").pni();
+					_p.pr("return false;").pnu();
+					_p.pr("}").upn();
+					_p.pr("}").upn();
+				}
+			}
+			_p.pr("return true;").pn();
+		}
+
+		QString serialCall(CellData *cell, const QString &rec, const QString &var, const QString &expr) {
+			VarData *vardata = cell->to<VarData>();
+			if(vardata) {
+				if(vardata->type->builtin() == TypeData::StructReference)
+					throw Exception("struct references are not serializable: " + vardata->name);
+				return var + expr + ")";
+			}
+			CellContainerData *container = cell->to<CellContainerData>();
+			if(!container) {
+				Q_ASSERT(false);
+			}
+			return rec.arg(container->elemid) + expr + ")";
 		}
 
 		void genCellAccessor(const QString &sname, const QList<CellData*> &cells) {
@@ -327,8 +687,6 @@ class Generator {
 
 		void genDeclMeta() {
 			size_t n;
-			_p.pr("extern const DeclMeta meta;").pn();
-
 			_p.pr("#ifdef IMPLEMENTATION").opn(0);
 			_p.pr("const DeclMeta meta = {").pni();
 			
@@ -432,7 +790,7 @@ class Generator {
 						_p.pr(", .type = DeclDynid::VarType");
 					_p.pr(", .u = {");
 					if(it.field) {
-						_p.pr(" .field = ").pr(fieldGlobalIndex(it.key, it.field));
+						_p.pr(" .field = ").pr(fieldGlobalIndex(it.key, it.field)).pr(" }");
 					}
 					else {
 						CellData *cur = it.var;
@@ -444,6 +802,7 @@ class Generator {
 						}
 
 						_p.pr(" .value = { .decl = &").pr(lowername(it.value->fullname)).pr(", .varpath = (size_t[]){ ");
+						size_t nVarpath = path.size();
 						bool first = true;
 						while(!path.isEmpty()) {
 							if(first)
@@ -452,14 +811,19 @@ class Generator {
 								_p.pr(", ");
 							_p.pr(path.pop());
 						}
-						_p.pr(" }");
+						_p.pr(" }, .nVarpath = ").pr(nVarpath).pr(" } }");
 //						_p.pr(" .var = ").pr(lowername(it.var));
 					}
-					_p.pr(" } } },").pn();
+					_p.pr(", .refs = (DeclDynidRef[]){");
+					for(auto refit : it.refs)
+						_p.pr(" { .key = &").pr(lowername(refit.key->fullname)).pr(", .field = ").pr(fieldGlobalIndex(refit.key, refit.field)).pr(" },");
+					_p.pr(" }, .nRefs = ").pr(it.refs.size()).pr(" },").pn();
 				}
 				_p.pr("},").upn();
-				_p.pr(".nOwners = ").pr(type->owners.size()).pn();
+				_p.pr(".nOwners = ").pr(type->owners.size()).pr(",").pn();
 			}
+			_p.pr(".ordinal = ").pr(_typeOrdinal.value(type)).pr(",").pn();
+			_p.pr(".enumOrdinal = ").pr(_enumOrdinal.value(type)).pn();
 			_p.pr("};").upn();
 			_p.pr("#endif").opn(0);
 		}
@@ -532,7 +896,8 @@ class Generator {
 			_p.pr(".nSubKeys = ").pr(key->subs.size()).pr(",").pn();
 			ValueData *mapto = _model->mapto(key);
 			if(mapto)
-				_p.pr(".mapto = &").pr(lowername(mapto->fullname)).pn();
+				_p.pr(".mapto = &").pr(lowername(mapto->fullname)).pr(",").pn();
+			_p.pr(".ordinal = ").pr(_keyOrdinal.value(key)).pn();
 			_p.pr("};").upn();
 			_p.pr("#endif").opn(0);
 			for(auto it : key->subs)
@@ -568,6 +933,8 @@ class Generator {
 
 			_p.pr("const DeclValue ").pr(lowername(value->fullname)).pr(" = {").pni();
 			_p.pr(".name = Name::").pr(uppername(value->fullname)).pr(",").pn();
+			_p.pr(".ordinal = ").pr(_model->values().indexOf(value)).pr(",").pn();
+			_p.pr(".meta = &meta,").pn();
 
 			total = 0;
 			for(auto it : value->rows)
@@ -683,81 +1050,102 @@ class Generator {
 		}
 
 		void genStructMapping(const QString &ns, StructData *strct) {
+			QString cls = ns + "::" + uppername(strct->fullname);
+			QVector<int> enumDense(_nEnumOrdinals, -1); //[ordinal] -> index in 'mapping', -1: not mapped
+			QVector<int> typeDense(_typeOrdinal.size(), -1);
+			QVector<int> keyDense(_keyOrdinal.size(), -1);
 			size_t nEnumMap = 0;
 			size_t nTypeMap = 0;
 			size_t nKeyMap = 0;
 			for(auto it : strct->aux)
-				if(it->source->id() == EnumData::Id)
-					nEnumMap++;
+				if(it->source->id() == EnumData::Id) {
+					EnumData *data = it->source->to<EnumData>();
+					enumDense[_enumOrdinal.value(data->owner) + data->index] = nEnumMap++;
+				}
 				else if(it->source->id() == TypeData::Id)
-					nTypeMap++;
+					typeDense[_typeOrdinal.value(it->source->to<TypeData>())] = nTypeMap++;
 				else if(it->source->id() == KeyData::Id)
-					nKeyMap++;
+					keyDense[_keyOrdinal.value(it->source->to<KeyData>())] = nKeyMap++;
 				else
 					printf("missing aux mapping handler for data source %d\n", it->source->id());
 
-			_p.pr("template<> struct Mapping<DeclEnum, ").pr(ns).pr("::").pr(uppername(strct->fullname)).pr("> : MappingImpl<DeclEnum, ").pr(ns).pr("::").pr(uppername(strct->fullname)).pr(", ").pr(nEnumMap).pr("> {};").pn();
+			_p.pr("template<> struct Mapping<DeclEnum, ").pr(cls).pr("> : MappingImpl<DeclEnum, ").pr(cls).pr(", ").pr(nEnumMap).pr("> {};").pn();
 			if(nEnumMap > 0) {
 				size_t index = 0;
 
 				_p.pr("#ifdef IMPLEMENTATION").opn(0);
-				_p.pr("template<> const MappedValue<DeclEnum, ").pr(ns).pr("::").pr(uppername(strct->fullname)).pr("> MappingImpl<DeclEnum, ").pr(ns).pr("::").pr(uppername(strct->fullname)).pr(", ").pr(nEnumMap).pr(">::mapping[N] = {").pni();
+				_p.pr("template<> const MappedValue<DeclEnum, ").pr(cls).pr("> MappingImpl<DeclEnum, ").pr(cls).pr(", ").pr(nEnumMap).pr(">::mapping[N] = {").pni();
 				for(auto it : strct->aux) {
 					if(it->source->id() == EnumData::Id) {
 						EnumData *data = it->source->to<EnumData>();
 						_p.pr("{").pni();
 						_p.pr(".type = &").pr(ns).pr("::").pr(lowername(data->owner->fullname)).pr(",").pn();
 						_p.pr(".value = ").pr(data->index).pr(",").pn();
-						_p.pr(".aux = ").pr(ns).pr("::").pr(uppername(strct->fullname)).pr("::Aux + ").pr(index).pr(",").pn();
+						_p.pr(".aux = ").pr(cls).pr("::Aux + ").pr(index).pr(",").pn();
 						_p.pr("},").upn();
 					}
 					index++;
 				}
 				_p.pr("};").upn();
+				genDense("DeclEnum", cls, nEnumMap, enumDense);
 				_p.pr("#endif").opn(0);
 			}
 
-			_p.pr("template<> struct Mapping<DeclType, ").pr(ns).pr("::").pr(uppername(strct->fullname)).pr("> : MappingImpl<DeclType, ").pr(ns).pr("::").pr(uppername(strct->fullname)).pr(", ").pr(nTypeMap).pr("> {};").pn();
+			_p.pr("template<> struct Mapping<DeclType, ").pr(cls).pr("> : MappingImpl<DeclType, ").pr(cls).pr(", ").pr(nTypeMap).pr("> {};").pn();
 			if(nTypeMap > 0) {
 				size_t index = 0;
 
 				_p.pr("#ifdef IMPLEMENTATION").opn(0);
-				_p.pr("template<> const MappedValue<DeclType, ").pr(ns).pr("::").pr(uppername(strct->fullname)).pr("> MappingImpl<DeclType, ").pr(ns).pr("::").pr(uppername(strct->fullname)).pr(", ").pr(nTypeMap).pr(">::mapping[N] = {").pni();
+				_p.pr("template<> const MappedValue<DeclType, ").pr(cls).pr("> MappingImpl<DeclType, ").pr(cls).pr(", ").pr(nTypeMap).pr(">::mapping[N] = {").pni();
 				for(auto it : strct->aux) {
 					if(it->source->id() == TypeData::Id) {
 						TypeData *data = it->source->to<TypeData>();
 						_p.pr("{").pni();
 						_p.pr(".type = &").pr(ns).pr("::").pr(lowername(data->fullname)).pr(",").pn();
-						_p.pr(".aux = ").pr(ns).pr("::").pr(uppername(strct->fullname)).pr("::Aux + ").pr(index).pr(",").pn();
+						_p.pr(".aux = ").pr(cls).pr("::Aux + ").pr(index).pr(",").pn();
 						_p.pr("},").upn();
 					}
 					index++;
 				}
 				_p.pr("};").upn();
+				genDense("DeclType", cls, nTypeMap, typeDense);
 				_p.pr("#endif").opn(0);
 			}
 
-			_p.pr("template<> struct Mapping<DeclKey, ").pr(ns).pr("::").pr(uppername(strct->fullname)).pr("> : MappingImpl<DeclKey, ").pr(ns).pr("::").pr(uppername(strct->fullname)).pr(", ").pr(nKeyMap).pr("> {};").pn();
+			_p.pr("template<> struct Mapping<DeclKey, ").pr(cls).pr("> : MappingImpl<DeclKey, ").pr(cls).pr(", ").pr(nKeyMap).pr("> {};").pn();
 			if(nKeyMap > 0) {
 				size_t index = 0;
 
 				_p.pr("#ifdef IMPLEMENTATION").opn(0);
-				_p.pr("template<> const MappedValue<DeclKey, ").pr(ns).pr("::").pr(uppername(strct->fullname)).pr("> MappingImpl<DeclKey, ").pr(ns).pr("::").pr(uppername(strct->fullname)).pr(", ").pr(nKeyMap).pr(">::mapping[N] = {").pni();
+				_p.pr("template<> const MappedValue<DeclKey, ").pr(cls).pr("> MappingImpl<DeclKey, ").pr(cls).pr(", ").pr(nKeyMap).pr(">::mapping[N] = {").pni();
 				for(auto it : strct->aux) {
 					if(it->source->id() == KeyData::Id) {
 						KeyData *data = it->source->to<KeyData>();
 						_p.pr("{").pni();
 						_p.pr(".key = &").pr(ns).pr("::").pr(lowername(data->fullname)).pr(",").pn();
-						_p.pr(".aux = ").pr(ns).pr("::").pr(uppername(strct->fullname)).pr("::Aux + ").pr(index).pr(",").pn();
+						_p.pr(".aux = ").pr(cls).pr("::Aux + ").pr(index).pr(",").pn();
 						_p.pr("},").upn();
 					}
 					index++;
 				}
 				_p.pr("};").upn();
+				genDense("DeclKey", cls, nKeyMap, keyDense);
 				_p.pr("#endif").opn(0);
 			}
 		}
 
+		//direct lookup table: [ordinal] -> mapping entry
+		void genDense(const char *decl, const QString &cls, size_t n, const QVector<int> &dense) {
+			_p.pr("template<> const size_t MappingImpl<").pr(decl).pr(", ").pr(cls).pr(", ").pr(n).pr(">::nDense = ").pr(dense.size()).pr(";").pn();
+			_p.pr("template<> const MappedValue<").pr(decl).pr(", ").pr(cls).pr("> *const MappingImpl<").pr(decl).pr(", ").pr(cls).pr(", ").pr(n).pr(">::dense[] = {").pni();
+			for(auto it : dense)
+				if(it < 0)
+					_p.pr("nullptr,").pn();
+				else
+					_p.pr("mapping + ").pr(it).pr(",").pn();
+			_p.pr("};").upn();
+		}
+
 		void genAuxValue(AuxData *aux) {
 			for(auto it : aux->strct->members) {
 				QString value = aux->values.value(it->name);
@@ -941,6 +1329,10 @@ class Generator {
 		}
 
 		Model *_model;
+		QHash<const TypeData*, size_t> _typeOrdinal;
+		QHash<const TypeData*, size_t> _enumOrdinal; //ordinal of first enum value
+		QHash<const KeyData*, size_t> _keyOrdinal;
+		size_t _nEnumOrdinals;
 
 		Printer _p;
 };
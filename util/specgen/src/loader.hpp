@@ -326,6 +326,23 @@ class DirectLoader : public Loader {
 		}
 
 		void ref(XmlModelHandlerFrame *frame, const QXmlAttributes &attr) {
+			Namespace *ns = frame->topmost<Namespace>();
+			Type *type = frame->topmost<Type>();
+			QString attrKey = attr.value("key");
+			QString attrField = attr.value("field");
+			if(attrKey.isEmpty())
+				throw Exception("missing 'key' attribute");
+			else if(attrField.isEmpty())
+				throw Exception("missing 'field' attribute");
+			else if(type->data->owners.isEmpty())
+				throw Exception("'ref' outside of 'owner'");
+			KeyData *key = model()->lookup<KeyData>(ns->path, attrKey);
+			FieldData *field = key->bynameField.value(attrField);
+			if(!field)
+				throw Exception("no such field for given key");
+			else if(field->type != type->data)
+				throw Exception("given field does not have expected type");
+			type->data->owners.last().refs.append(TypeData::Ref(key, field));
 		}
 
 		void value(XmlModelHandlerFrame *&frame, const QXmlAttributes &attr) {
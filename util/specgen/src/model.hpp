@@ -85,6 +85,14 @@ struct TypeData : NestedData {
 		Null, Boolean, U8, U16, U32, U64, FlexString, KeyReference, TypeReference, StructReference, User
 	};
 
+	struct Ref {
+		Ref() {}
+		Ref(KeyData *key, FieldData *field) : key(key), field(field) {}
+
+		KeyData *key = nullptr;
+		FieldData *field = nullptr;
+	};
+
 	struct Owner {
 		Owner() {}
 		Owner(KeyData *key, FieldData *field) : key(key), field(field) {}
@@ -94,6 +102,7 @@ struct TypeData : NestedData {
 		FieldData *field = nullptr;
 		ValueData *value = nullptr;
 		VarData *var = nullptr;
+		QList<Ref> refs;
 	};
 
 	~TypeData() {
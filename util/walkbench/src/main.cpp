@@ -0,0 +1,116 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QDir>
+
+#include "qtfe/qtfe.h"
+
+//times Value::constWalk() against the statically dispatched spec::walk() over all values of a database
+
+namespace {
+	struct Counter {
+		size_t nodes = 0;
+		size_t vars = 0;
+	};
+
+	struct CountingVisitor {
+		Counter *counter;
+
+		void down(spec::Name name, size_t n) { counter->nodes++; }
+		void up() {}
+		void begin(size_t index) { counter->nodes++; }
+		void end() {}
+		template<typename T> void var(size_t index, const spec::DeclType *type, const T &value) { counter->vars++; }
+	};
+
+	struct Sample {
+		qint64 nsecs;
+		Counter counter;
+	};
+
+	Sample timeConstWalk(const QList<const spec::Value*> &values, int repeat)
+	{
+		Sample result;
+		spec::Value::ConstWalker walker;
+		walker.down = [&](spec::Name name, size_t n) { result.counter.nodes++; };
+		walker.up = []() {};
+		walker.begin = [&](size_t index, const spec::ValueAccessor *accessor, const void *handle) { result.counter.nodes++; };
+		walker.end = []() {};
+		walker.var = [&](size_t index, const spec::DeclType *type, const void *handle) { result.counter.vars++; };
+
+		QElapsedTimer timer;
+		timer.start();
+		for(int i = 0; i < repeat; i++)
+			for(const spec::Value *value : values)
+				value->constWalk(walker);
+		result.nsecs = timer.nsecsElapsed();
+		return result;
+	}
+
+	Sample timeWalk(const QList<const spec::Value*> &values, int repeat)
+	{
+		Sample result;
+		CountingVisitor visitor { &result.counter };
+
+		QElapsedTimer timer;
+		timer.start();
+		for(int i = 0; i < repeat; i++)
+			for(const spec::Value *value : values)
+				spec::walk(*value, visitor);
+		result.nsecs = timer.nsecsElapsed();
+		return result;
+	}
+
+	void print(const char *name, const Sample &sample, int repeat)
+	{
+		printf("%-10s %10.3f ms total, %8.3f ms per pass, %zu nodes, %zu vars\n", name, sample.nsecs / 1e6, sample.nsecs / 1e6 / repeat, sample.counter.nodes / repeat, sample.counter.vars / repeat);
+	}
+}
+
+int main(int argn, char **argv)
+{
+	QCoreApplication app(argn, argv);
+	QCommandLineParser parser;
+	parser.addHelpOption();
+	parser.addPositionalArgument("database", "Database directory");
+	parser.addOption({ { "r", "repeat" }, "Number of passes over all values", "count", "10" });
+	parser.process(app);
+
+	if(parser.positionalArguments().size() != 1) {
+		printf("Invalid arguments\n");
+		parser.showHelp();
+		return 1;
+	}
+	bool ok;
+	int repeat = parser.value("repeat").toInt(&ok);
+	if(!ok || repeat <= 0) {
+		printf("Invalid repeat count\n");
+		return 1;
+	}
+
+	spec::v1_0::DirFrontend fe(QDir(parser.positionalArguments().at(0)));
+	QList<const spec::Value*> values;
+	try {
+		fe.load();
+		fe.foreachKV([&](const QByteArray &key, const spec::Value *value) {
+			values.append(value);
+		});
+	}
+	catch(const Exception &e) {
+		printf("Error loading database: %s\n", qPrintable(e.message()));
+		return 1;
+	}
+	printf("%d values, %d passes\n", values.size(), repeat);
+
+	//one untimed pass each, so both start with warm caches
+	timeConstWalk(values, 1);
+	timeWalk(values, 1);
+
+	Sample dynamic = timeConstWalk(values, repeat);
+	Sample stat = timeWalk(values, repeat);
+	print("constWalk", dynamic, repeat);
+	print("spec::walk", stat, repeat);
+	if(dynamic.counter.nodes != stat.counter.nodes || dynamic.counter.vars != stat.counter.vars)
+		printf("warning: walks visited different numbers of nodes\n");
+	return 0;
+}